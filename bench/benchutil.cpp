@@ -0,0 +1,81 @@
+#include "benchutil.hpp"
+#include <algorithm>
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <sys/time.h>
+
+static const double SAMPLE_TIME = 0.02;
+static const int NUM_SAMPLES = 11;
+
+static volatile double sink;
+
+double currentTime()
+{
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+
+  return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+void consume(const double value)
+{
+  sink = sink + value;
+}
+
+/* *** Benchmark *** */
+
+Benchmark::Benchmark(const std::string& name, const int size, const int raysPerOp)
+  : m_name(name), m_size(size), m_raysPerOp(raysPerOp)
+{
+}
+
+Benchmark::~Benchmark()
+{
+}
+
+double Benchmark::timeRun(const long iterations)
+{
+  double start = currentTime();
+  run(iterations);
+  return currentTime() - start;
+}
+
+void Benchmark::measure()
+{
+  static bool printedHeader = false;
+  if (!printedHeader) {
+    std::cout << std::left << std::setw(36) << "benchmark" << std::right << std::setw(7) << "size"
+              << std::setw(12) << "median" << std::setw(10) << "min" << std::setw(10) << "p90"
+              << "  ns/op" << std::setw(12) << "Mrays/s" << std::endl;
+    printedHeader = true;
+  }
+
+  // Doubling the iterations until a run is long enough also warms up the
+  // caches and branch predictors.
+  long iterations = 1;
+  while (timeRun(iterations) < SAMPLE_TIME) {
+    iterations *= 2;
+  }
+
+  std::vector<double> samples;
+  for (int i = 0; i < NUM_SAMPLES; i++) {
+    samples.push_back(1e9 * timeRun(iterations) / iterations);
+  }
+  std::sort(samples.begin(), samples.end());
+  double median = samples[NUM_SAMPLES / 2];
+
+  std::cout << std::left << std::setw(36) << m_name << std::right << std::setw(7);
+  if (m_size > 0) {
+    std::cout << m_size;
+  } else {
+    std::cout << "-";
+  }
+  std::cout << std::fixed << std::setprecision(1) << std::setw(12) << median
+            << std::setw(10) << samples.front()
+            << std::setw(10) << samples[(NUM_SAMPLES - 1) * 9 / 10] << "  ns/op";
+  if (m_raysPerOp > 0) {
+    std::cout << std::setw(12) << std::setprecision(2) << 1e3 * m_raysPerOp / median;
+  }
+  std::cout << std::endl;
+}
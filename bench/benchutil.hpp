@@ -0,0 +1,41 @@
+#ifndef BENCHUTIL_HPP
+#define BENCHUTIL_HPP
+
+#include <string>
+
+/*
+  Minimal timing helpers for the micro benchmarks.
+  Each benchmark is warmed up, sized so one sample takes about 20ms, then
+  timed over several samples. The median sample is reported along with the
+  fastest and the 90th percentile, so noisy runs show up as a spread rather
+  than a wrong number.
+*/
+
+double currentTime();
+
+// Keeps the compiler from optimizing away a result.
+void consume(const double value);
+
+class Benchmark {
+ public:
+  // size is printed beside the name if it's positive. Benchmarks tracing
+  // raysPerOp rays in each operation also report rays per second.
+  Benchmark(const std::string& name, const int size, const int raysPerOp = 0);
+  virtual ~Benchmark();
+
+  // Times the benchmark and prints one result line.
+  void measure();
+
+ protected:
+  // Performs iterations operations.
+  virtual void run(const long iterations) = 0;
+
+ private:
+  double timeRun(const long iterations);
+
+  std::string m_name;
+  int m_size;
+  int m_raysPerOp;
+};
+
+#endif
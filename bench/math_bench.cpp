@@ -0,0 +1,112 @@
+#include <cstddef>
+#include <vector>
+#include "algebra.hpp"
+#include "polyroots.hpp"
+#include "transforms.hpp"
+#include "random.hpp"
+#include "benchutil.hpp"
+
+static const int NUM_INPUTS = 1024;
+
+enum RootsOperation { QUADRATIC, CUBIC, QUARTIC };
+
+// Polynomials with coefficients in [-4, 4), a mix of ones with and without
+// real roots.
+class RootsBench : public Benchmark {
+ public:
+  RootsBench(const char* name, const RootsOperation op)
+    : Benchmark(name, 0), m_op(op)
+  {
+    Random random(op);
+    for (int i = 0; i < 4 * NUM_INPUTS; i++) {
+      m_coeffs.push_back(8.0 * random.nextDouble() - 4.0);
+    }
+  }
+
+ protected:
+  void run(const long iterations)
+  {
+    double roots[4];
+    for (long i = 0; i < iterations; i++) {
+      const double* c = &m_coeffs[4 * (i % NUM_INPUTS)];
+      size_t n = 0;
+      switch (m_op) {
+        case QUADRATIC:
+          n = quadraticRoots(c[0], c[1], c[2], roots);
+          break;
+        case CUBIC:
+          n = cubicRoots(c[0], c[1], c[2], roots);
+          break;
+        case QUARTIC:
+          n = quarticRoots(c[0], c[1], c[2], c[3], roots);
+          break;
+      }
+      consume(n > 0 ? roots[0] : 0.0);
+    }
+  }
+
+ private:
+  RootsOperation m_op;
+  std::vector<double> m_coeffs;
+};
+
+enum MatrixOperation { MULTIPLY, INVERT, TRANSFORM_POINT, TRANSFORM_VECTOR };
+
+// Random rotations, scales and translations, like the ones scene nodes hold.
+class MatrixBench : public Benchmark {
+ public:
+  MatrixBench(const char* name, const MatrixOperation op)
+    : Benchmark(name, 0), m_op(op)
+  {
+    Random random(op);
+    for (int i = 0; i < NUM_INPUTS; i++) {
+      Vector3D offset(random.nextDouble(), random.nextDouble(), random.nextDouble());
+      Vector3D scale(0.5 + random.nextDouble(), 0.5 + random.nextDouble(), 0.5 + random.nextDouble());
+      m_matrices.push_back(translation(10.0 * offset) *
+                           rotation(360.0 * random.nextDouble(), 'x') *
+                           rotation(360.0 * random.nextDouble(), 'y') *
+                           scaling(scale));
+      m_points.push_back(Point3D(random.nextDouble(), random.nextDouble(), random.nextDouble()));
+    }
+  }
+
+ protected:
+  void run(const long iterations)
+  {
+    for (long i = 0; i < iterations; i++) {
+      const int j = i % NUM_INPUTS;
+      const Matrix4x4& m = m_matrices[j];
+      switch (m_op) {
+        case MULTIPLY:
+          consume((m * m_matrices[(j + 1) % NUM_INPUTS])[0][0]);
+          break;
+        case INVERT:
+          consume(m.invert()[0][0]);
+          break;
+        case TRANSFORM_POINT:
+          consume((m * m_points[j])[0]);
+          break;
+        case TRANSFORM_VECTOR:
+          consume((m * (m_points[j] - Point3D()))[0]);
+          break;
+      }
+    }
+  }
+
+ private:
+  MatrixOperation m_op;
+  std::vector<Matrix4x4> m_matrices;
+  std::vector<Point3D> m_points;
+};
+
+int main()
+{
+  RootsBench("quadraticRoots", QUADRATIC).measure();
+  RootsBench("cubicRoots", CUBIC).measure();
+  RootsBench("quarticRoots", QUARTIC).measure();
+
+  MatrixBench("Matrix4x4 * Matrix4x4", MULTIPLY).measure();
+  MatrixBench("Matrix4x4::invert", INVERT).measure();
+  MatrixBench("Matrix4x4 * Point3D", TRANSFORM_POINT).measure();
+  MatrixBench("Matrix4x4 * Vector3D", TRANSFORM_VECTOR).measure();
+}
@@ -0,0 +1,172 @@
+#include <cmath>
+#include <vector>
+#include "primitive.hpp"
+#include "image_primitive.hpp"
+#include "shapes.hpp"
+#include "random.hpp"
+#include "benchutil.hpp"
+
+static const int NUM_RAYS = 1024;
+
+// Rays from random points around the origin aimed at random points in
+// bounds, so most hit the shape from all sides and a few graze past it.
+struct Rays {
+  Rays(const BoundingBox& bounds, const uint64_t seed)
+  {
+    Random random(seed);
+    const Point3D& lo = bounds.min();
+    const Point3D& hi = bounds.max();
+    for (int i = 0; i < NUM_RAYS; i++) {
+      double theta = 2.0 * M_PI * random.nextDouble();
+      double z = 2.0 * random.nextDouble() - 1.0;
+      double r = sqrt(1.0 - z * z);
+      Point3D eye(5.0 * r * cos(theta), 5.0 * r * sin(theta), 5.0 * z);
+
+      // Aim a little past the bounds so some rays miss.
+      Point3D target;
+      for (int a = 0; a < 3; a++) {
+        double t = 1.2 * random.nextDouble() - 0.1;
+        target[a] = lo[a] + t * (hi[a] - lo[a]);
+      }
+
+      m_eyes.push_back(eye);
+      m_rays.push_back(target - eye);
+    }
+  }
+
+  std::vector<Point3D> m_eyes;
+  std::vector<Vector3D> m_rays;
+};
+
+// What the renderer calls for each kind of shape.
+static bool trace(const Primitive& primitive, const Point3D& eye, const Vector3D& ray,
+                  HitList& hits)
+{
+  return primitive.filteredIntersect(eye, ray, hits);
+}
+
+static bool trace(const Polygon& polygon, const Point3D& eye, const Vector3D& ray,
+                  HitList& hits)
+{
+  return polygon.intersect(eye, ray, hits);
+}
+
+static bool trace(const Circle& circle, const Point3D& eye, const Vector3D& ray,
+                  HitList& hits)
+{
+  return circle.intersect(eye, ray, hits);
+}
+
+template <typename Shape>
+class RayBench : public Benchmark {
+ public:
+  RayBench(const char* name, const Shape& shape, const BoundingBox& bounds, const int size = 0)
+    : Benchmark(name, size, 1), m_shape(shape), m_rays(bounds, size)
+  {}
+
+ protected:
+  void run(const long iterations)
+  {
+    for (long i = 0; i < iterations; i++) {
+      const int r = i % NUM_RAYS;
+      HitList hits;
+      if (trace(m_shape, m_rays.m_eyes[r], m_rays.m_rays[r], hits)) {
+        consume(hits.front().m_t);
+      }
+    }
+  }
+
+ private:
+  const Shape& m_shape;
+  Rays m_rays;
+};
+
+template <typename Shape>
+static void measure(const char* name, const Shape& shape, const BoundingBox& bounds,
+                    const int size = 0)
+{
+  RayBench<Shape>(name, shape, bounds, size).measure();
+}
+
+// A unit sphere cut into rings of quads, with caps of triangles.
+static Mesh* sphereMesh(const int rings)
+{
+  std::vector<Point3D> verts;
+  std::vector< std::vector<int> > faces;
+  const int segments = 2 * rings;
+
+  verts.push_back(Point3D(0.0, 0.0, 1.0));
+  for (int i = 1; i < rings; i++) {
+    double phi = M_PI * i / rings;
+    for (int j = 0; j < segments; j++) {
+      double theta = 2.0 * M_PI * j / segments;
+      verts.push_back(Point3D(sin(phi) * cos(theta), sin(phi) * sin(theta), cos(phi)));
+    }
+  }
+  verts.push_back(Point3D(0.0, 0.0, -1.0));
+  const int bottom = verts.size() - 1;
+
+  for (int i = 0; i < rings; i++) {
+    for (int j = 0; j < segments; j++) {
+      const int next = (j + 1) % segments;
+      std::vector<int> face;
+      if (i == 0) {
+        face.push_back(0);
+        face.push_back(1 + j);
+        face.push_back(1 + next);
+      } else if (i == rings - 1) {
+        face.push_back(1 + (i - 1) * segments + j);
+        face.push_back(bottom);
+        face.push_back(1 + (i - 1) * segments + next);
+      } else {
+        face.push_back(1 + (i - 1) * segments + j);
+        face.push_back(1 + i * segments + j);
+        face.push_back(1 + i * segments + next);
+        face.push_back(1 + (i - 1) * segments + next);
+      }
+      faces.push_back(face);
+    }
+  }
+
+  return new Mesh(verts, faces);
+}
+
+int main()
+{
+  NonhierSphere nonhierSphere(Point3D(0.5, -0.5, 0.0), 1.5);
+  measure("NonhierSphere::filteredIntersect", nonhierSphere, nonhierSphere.getBounds());
+
+  Sphere sphere;
+  measure("Sphere::filteredIntersect", sphere, sphere.getBounds());
+
+  Cube cube;
+  measure("Cube::filteredIntersect", cube, cube.getBounds());
+
+  Cone cone;
+  measure("Cone::filteredIntersect", cone, cone.getBounds());
+
+  Cylinder cylinder;
+  measure("Cylinder::filteredIntersect", cylinder, cylinder.getBounds());
+
+  std::vector<Point3D> square;
+  square.push_back(Point3D(-1.0, -1.0, 0.0));
+  square.push_back(Point3D(1.0, -1.0, 0.0));
+  square.push_back(Point3D(1.0, 1.0, 0.0));
+  square.push_back(Point3D(-1.0, 1.0, 0.0));
+  Polygon polygon(square, Vector3D(0.0, 0.0, 1.0));
+  measure("Polygon::intersect", polygon, polygon.getBounds());
+
+  Circle circle(Vector3D(0.0, 0.0, 1.0), Point3D(0.0, 0.0, 0.0), 1.0);
+  measure("Circle::intersect", circle, polygon.getBounds());
+
+  ImagePrimitive image;
+  measure("ImagePrimitive::filteredIntersect", image, image.getBounds());
+
+  static const int rings[] = { 4, 16, 64 };
+  for (unsigned i = 0; i < sizeof(rings) / sizeof(rings[0]); i++) {
+    Mesh* mesh = sphereMesh(rings[i]);
+    // Sized by the number of faces.
+    measure("Mesh::filteredIntersect", *mesh, mesh->getBounds(), 2 * rings[i] * rings[i]);
+    delete mesh;
+  }
+}
@@ -0,0 +1,85 @@
+#include <cstdio>
+#include <iostream>
+#include <list>
+#include <vector>
+#include "renderer.hpp"
+#include "scene.hpp"
+#include "material.hpp"
+#include "primitive.hpp"
+#include "sampler.hpp"
+
+/*
+  Checks that a progressive render without -d takes new samples in each
+  pass rather than repeating the positions of the one before.
+*/
+
+static const int SIZE = 16;
+static const int NUM_SAMPLES = 4;
+static const char* IMAGE_FILE = "progressive_check.png";
+static const char* CHECKPOINT_FILE = "progressive_check.checkpoint";
+
+// Stratified samples, remembering every position handed out.
+class RecordingSampler : public Sampler {
+ public:
+  RecordingSampler() : Sampler(NUM_SAMPLES), m_sampler(NUM_SAMPLES) {}
+
+  void generate(Point2D* samples, Random& random) const
+  {
+    m_sampler.generate(samples, random);
+    m_samples.insert(m_samples.end(), samples, samples + NUM_SAMPLES);
+  }
+
+  mutable std::vector<Point2D> m_samples;
+
+ private:
+  StratifiedSampler m_sampler;
+};
+
+int main()
+{
+  SceneNode* root = new SceneNode("root");
+  GeometryNode* sphere = new GeometryNode("sphere", new Sphere());
+  sphere->set_material(new BasicMaterial(Colour(0.7, 0.2, 0.2), Colour(0.5), 25, 0.0, 1.0));
+  root->add_child(sphere);
+
+  Light* light = new Light();
+  light->colour = Colour(0.9);
+  light->position = Point3D(-10.0, 10.0, 15.0);
+  std::list<Light*> lights;
+  lights.push_back(light);
+
+  Scene scene(root, SIZE, SIZE, Point3D(0.0, 0.0, 5.0), Vector3D(0.0, 0.0, -1.0),
+              Vector3D(0.0, 1.0, 0.0), 50, Colour(0.2), lights);
+  scene.build();
+
+  // One thread, so both passes start from the same tiles.
+  std::remove(CHECKPOINT_FILE);
+  RecordingSampler* sampler = new RecordingSampler();
+  ProgressiveRenderer* renderer = new ProgressiveRenderer(&scene, sampler, 2, 1000.0,
+                                                          CHECKPOINT_FILE, 0);
+  renderer->render(IMAGE_FILE, 1);
+
+  const std::vector<Point2D>& samples = sampler->m_samples;
+  const size_t perPass = SIZE * SIZE * NUM_SAMPLES;
+  bool repeated = samples.size() == 2 * perPass;
+  for (size_t i = 0; repeated && i < perPass; i++) {
+    repeated = samples[i][0] == samples[perPass + i][0] &&
+               samples[i][1] == samples[perPass + i][1];
+  }
+
+  delete renderer;
+  std::remove(CHECKPOINT_FILE);
+  std::remove(IMAGE_FILE);
+
+  if (samples.size() != 2 * perPass) {
+    std::cout << "FAILED: took " << samples.size() << " samples, expected " << 2 * perPass
+              << std::endl;
+    return 1;
+  }
+  if (repeated) {
+    std::cout << "FAILED: the second pass repeated the samples of the first" << std::endl;
+    return 1;
+  }
+  std::cout << "Progressive passes take new samples: ok" << std::endl;
+  return 0;
+}
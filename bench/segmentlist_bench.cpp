@@ -0,0 +1,83 @@
+#include <algorithm>
+#include <vector>
+#include "segmentlist.hpp"
+#include "random.hpp"
+#include "benchutil.hpp"
+
+// n sorted, disjoint segments spread over [0, 100).
+static SegmentList randomSegments(const int n, Random& random)
+{
+  std::vector<double> ts;
+  for (int i = 0; i < 2 * n; i++) {
+    ts.push_back(100.0 * random.nextDouble());
+  }
+  std::sort(ts.begin(), ts.end());
+
+  SegmentList segments;
+  for (int i = 0; i < n; i++) {
+    segments.insert(IntersectionPoint(ts[2 * i]), IntersectionPoint(ts[2 * i + 1]), NULL);
+  }
+  return segments;
+}
+
+static double checksum(const SegmentList& segments)
+{
+  double sum = 0.0;
+  for (Segments::const_iterator it = segments.begin(); it != segments.end(); it++) {
+    sum += it->m_end.m_t - it->m_start.m_t;
+  }
+  return sum;
+}
+
+enum Operation { UNION, INTERSECTION, DIFFERENCE };
+
+class SegmentListBench : public Benchmark {
+ public:
+  SegmentListBench(const char* name, const Operation op, const int n)
+    : Benchmark(name, n), m_op(op)
+  {
+    Random random(n, op);
+    m_a = randomSegments(n, random);
+    m_b = randomSegments(n, random);
+  }
+
+ protected:
+  void run(const long iterations)
+  {
+    for (long i = 0; i < iterations; i++) {
+      SegmentList result = m_a;
+      SegmentList other = m_b;
+      switch (m_op) {
+        case UNION:
+          result.insert(other);
+          break;
+        case INTERSECTION:
+          result.intersect(other);
+          break;
+        case DIFFERENCE:
+          result.remove(other);
+          break;
+      }
+      consume(checksum(result));
+    }
+  }
+
+ private:
+  Operation m_op;
+  SegmentList m_a;
+  SegmentList m_b;
+};
+
+int main()
+{
+  static const int sizes[] = { 2, 4, 8, 16, 32, 64 };
+  for (unsigned i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+    SegmentListBench("SegmentList::insert", UNION, sizes[i]).measure();
+  }
+  for (unsigned i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+    SegmentListBench("SegmentList::intersect", INTERSECTION, sizes[i]).measure();
+  }
+  for (unsigned i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+    SegmentListBench("SegmentList::remove", DIFFERENCE, sizes[i]).measure();
+  }
+}
@@ -0,0 +1,89 @@
+#include <cmath>
+#include <iostream>
+#include <vector>
+#include "material.hpp"
+#include "primitive.hpp"
+#include "image.hpp"
+#include "random.hpp"
+#include "benchutil.hpp"
+
+static const int NUM_POINTS = 1024;
+
+// Run from the bench directory.
+static const char* TEXTURE_FILE = "../data/Checkerboard.png";
+
+static Vector3D randomDirection(Random& random)
+{
+  double theta = 2.0 * M_PI * random.nextDouble();
+  double z = 2.0 * random.nextDouble() - 1.0;
+  double r = sqrt(1.0 - z * z);
+  return Vector3D(r * cos(theta), r * sin(theta), z);
+}
+
+// Shades points on a unit sphere seen from random directions, lit by
+// numLights lights.
+class MaterialBench : public Benchmark {
+ public:
+  MaterialBench(const char* name, const PhongMaterial& material, const int numLights)
+    : Benchmark(name, numLights), m_material(material)
+  {
+    Random random(numLights);
+    for (int i = 0; i < numLights; i++) {
+      Light* light = new Light();
+      light->colour = Colour(0.5, 0.5, 0.5);
+      light->position = Point3D() + 10.0 * randomDirection(random);
+      m_lights.push_back(light);
+    }
+    for (int i = 0; i < NUM_POINTS; i++) {
+      Vector3D normal = randomDirection(random);
+      Vector3D view = randomDirection(random);
+      if (view.dot(normal) < 0.0) {
+        view = -1 * view;
+      }
+      m_normals.push_back(normal);
+      m_views.push_back(view);
+    }
+  }
+
+  ~MaterialBench()
+  {
+    for (LightList::const_iterator it = m_lights.begin(); it != m_lights.end(); it++) {
+      delete *it;
+    }
+  }
+
+ protected:
+  void run(const long iterations)
+  {
+    const Colour ambient(0.1);
+    for (long i = 0; i < iterations; i++) {
+      const int j = i % NUM_POINTS;
+      Point3D poi = Point3D() + m_normals[j];
+      consume(m_material.getColour(m_normals[j], m_views[j], m_lights, ambient,
+                                   poi, &m_sphere).R());
+    }
+  }
+
+ private:
+  const PhongMaterial& m_material;
+  Sphere m_sphere;
+  LightList m_lights;
+  std::vector<Vector3D> m_normals;
+  std::vector<Vector3D> m_views;
+};
+
+int main()
+{
+  BasicMaterial basic(Colour(0.7, 0.2, 0.2), Colour(0.5), 25, 0.0, 1.0);
+  MaterialBench("PhongMaterial::getColour", basic, 1).measure();
+  MaterialBench("PhongMaterial::getColour", basic, 4).measure();
+
+  Image texture;
+  if (!texture.loadPng(TEXTURE_FILE)) {
+    std::cout << "Skipping texture lookups, " << TEXTURE_FILE << " not found" << std::endl;
+    return 0;
+  }
+  TextureMap textured(TEXTURE_FILE, Colour(0.5), 25, 0.0, 1.0);
+  MaterialBench("TextureMap::getColour", textured, 1).measure();
+  MaterialBench("TextureMap::getColour", textured, 4).measure();
+}
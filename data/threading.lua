@@ -1,12 +1,10 @@
-require('readobj')
-
 hide = gr.material({0.84, 0.6, 0.53}, {0.3, 0.3, 0.3}, 20)
 
 -- #############################################
 -- Read in the cow model from a separate file.
 -- #############################################
 
-cow_poly = gr.mesh('cow', readobj('cow.obj'))
+cow_poly = gr.obj('cow', 'cow.obj')
 factor = 2.0/(2.76+3.637)
 
 cow_poly:set_material(hide)
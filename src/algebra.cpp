@@ -18,7 +18,7 @@ bool equal(const double d1, const double d2, const double e) {
   return d1 > d2 - e && d1 < d2 + e;
 }
 
-double Vector3D::normalize()
+Real Vector3D::normalize()
 {
   double denom = 1.0;
   double x = (v_[0] > 0.0) ? v_[0] : -v_[0];
@@ -18,11 +18,25 @@
 #include <iostream>
 #include <algorithm>
 #include <cmath>
+#include <cfloat>
+#include <limits>
+#include "inlinevector.hpp"
 
 #ifndef M_PI
 #define M_PI 3.14159265358979323846
 #endif
 
+// Scalar type points and vectors are stored and traced in. Building with
+// RT_FLOAT halves the size of geometry and hierarchies; matrices, colours
+// and root finding stay in double either way.
+#ifdef RT_FLOAT
+typedef float Real;
+#define REAL_MAX FLT_MAX
+#else
+typedef double Real;
+#define REAL_MAX DBL_MAX
+#endif
+
 const double epsilon = 0.0001;
 const double tightEpsilon = 0.0000001;
 
@@ -40,7 +54,7 @@ public:
     v_[0] = 0.0;
     v_[1] = 0.0;
   }
-  Point2D(double x, double y)
+  Point2D(Real x, Real y)
   { 
     v_[0] = x;
     v_[1] = y;
@@ -58,17 +72,17 @@ public:
     return *this;
   }
 
-  double& operator[](size_t idx) 
+  Real& operator[](size_t idx) 
   {
     return v_[ idx ];
   }
-  double operator[](size_t idx) const 
+  Real operator[](size_t idx) const 
   {
     return v_[ idx ];
   }
 
 private:
-  double v_[2];
+  Real v_[2];
 };
 
 class Point3D
@@ -80,7 +94,7 @@ public:
     v_[1] = 0.0;
     v_[2] = 0.0;
   }
-  Point3D(double x, double y, double z)
+  Point3D(Real x, Real y, Real z)
   { 
     v_[0] = x;
     v_[1] = y;
@@ -101,17 +115,17 @@ public:
     return *this;
   }
 
-  double& operator[](size_t idx) 
+  Real& operator[](size_t idx) 
   {
     return v_[ idx ];
   }
-  double operator[](size_t idx) const 
+  Real operator[](size_t idx) const 
   {
     return v_[ idx ];
   }
 
 private:
-  double v_[3];
+  Real v_[3];
 };
 
 inline Point3D operator *(double s, const Point3D& p)
@@ -133,7 +147,7 @@ public:
     v_[1] = 0.0;
     v_[2] = 0.0;
   }
-  Vector3D(double x, double y, double z)
+  Vector3D(Real x, Real y, Real z)
   { 
     v_[0] = x;
     v_[1] = y;
@@ -161,23 +175,25 @@ public:
     return *this;
   }
 
-  double& operator[](size_t idx) 
+  Real& operator[](size_t idx) 
   {
     return v_[ idx ];
   }
-  double operator[](size_t idx) const 
+  Real operator[](size_t idx) const 
   {
     return v_[ idx ];
   }
 
+  // Products are summed in double, so quadratics built from them don't
+  // lose their roots to cancellation when Real is float.
   double dot(const Vector3D& other) const
   {
-    return v_[0]*other.v_[0] + v_[1]*other.v_[1] + v_[2]*other.v_[2];
+    return (double)v_[0]*other.v_[0] + (double)v_[1]*other.v_[1] + (double)v_[2]*other.v_[2];
   }
 
   double length2() const
   {
-    return v_[0]*v_[0] + v_[1]*v_[1] + v_[2]*v_[2];
+    return (double)v_[0]*v_[0] + (double)v_[1]*v_[1] + (double)v_[2]*v_[2];
   }
   double length() const
   {
@@ -189,7 +205,7 @@ public:
            v_[2] > -epsilon && v_[2] < epsilon;
   }
 
-  double normalize();
+  Real normalize();
 
   Vector3D cross(const Vector3D& other) const
   {
@@ -200,7 +216,7 @@ public:
   }
 
 private:
-  double v_[3];
+  Real v_[3];
 };
 
 inline Vector3D operator *(double s, const Vector3D& v)
@@ -561,6 +577,19 @@ struct IntersectionPoint {
   Point3D m_primitivePOI;
 };
 
+// Intersections of a ray with a single primitive, most have only a few.
+typedef InlineVector<IntersectionPoint, 8> HitList;
+
+// Where along a ray leaving p to start looking for hits, so the ray clears
+// the surface it starts on. The rounding error in p grows with the size of
+// its coordinates and the precision of Real, and so does the offset, but
+// it's never less than epsilon.
+inline double rayOffset(const Point3D& p)
+{
+  const double size = std::max(std::max(std::fabs(p[0]), std::fabs(p[1])), std::fabs(p[2]));
+  return std::max(epsilon, 256.0 * std::numeric_limits<Real>::epsilon() * size);
+}
+
 bool solve3x2System(const Vector3D& A1, const Vector3D& A2, const Vector3D& B, Point2D& x);
 void tests();
 
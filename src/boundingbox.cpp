@@ -0,0 +1,188 @@
+#include "boundingbox.hpp"
+#include "stats.hpp"
+#include <cfloat>
+
+BoundingBox::BoundingBox()
+  : m_min(REAL_MAX, REAL_MAX, REAL_MAX),
+    m_max(-REAL_MAX, -REAL_MAX, -REAL_MAX)
+{
+}
+
+BoundingBox::BoundingBox(const Point3D& min, const Point3D& max)
+  : m_min(min), m_max(max)
+{
+}
+
+void BoundingBox::extend(const Point3D& p)
+{
+  for (int i = 0; i < 3; i++) {
+    if (p[i] < m_min[i]) m_min[i] = p[i];
+    if (p[i] > m_max[i]) m_max[i] = p[i];
+  }
+}
+
+void BoundingBox::extend(const BoundingBox& other)
+{
+  if (other.isEmpty()) {
+    return;
+  }
+
+  extend(other.m_min);
+  extend(other.m_max);
+}
+
+void BoundingBox::clip(const BoundingBox& other)
+{
+  for (int i = 0; i < 3; i++) {
+    if (other.m_min[i] > m_min[i]) m_min[i] = other.m_min[i];
+    if (other.m_max[i] < m_max[i]) m_max[i] = other.m_max[i];
+  }
+}
+
+void BoundingBox::pad(const double amount)
+{
+  if (isEmpty()) {
+    return;
+  }
+
+  for (int i = 0; i < 3; i++) {
+    m_min[i] -= amount;
+    m_max[i] += amount;
+  }
+}
+
+bool BoundingBox::isEmpty() const
+{
+  return m_min[0] > m_max[0] || m_min[1] > m_max[1] || m_min[2] > m_max[2];
+}
+
+Point3D BoundingBox::center() const
+{
+  return Point3D((m_min[0] + m_max[0]) / 2.0,
+                 (m_min[1] + m_max[1]) / 2.0,
+                 (m_min[2] + m_max[2]) / 2.0);
+}
+
+double BoundingBox::surfaceArea() const
+{
+  if (isEmpty()) {
+    return 0.0;
+  }
+
+  Vector3D d = m_max - m_min;
+  return 2.0 * (d[0] * d[1] + d[1] * d[2] + d[2] * d[0]);
+}
+
+int BoundingBox::longestAxis() const
+{
+  Vector3D d = m_max - m_min;
+  if (d[0] > d[1] && d[0] > d[2]) {
+    return 0;
+  }
+  return d[1] > d[2] ? 1 : 2;
+}
+
+BoundingBox BoundingBox::transform(const Matrix4x4& m) const
+{
+  BoundingBox box;
+  if (isEmpty()) {
+    return box;
+  }
+
+  // Transform all 8 corners.
+  for (int i = 0; i < 8; i++) {
+    Point3D corner((i & 1) ? m_max[0] : m_min[0],
+                   (i & 2) ? m_max[1] : m_min[1],
+                   (i & 4) ? m_max[2] : m_min[2]);
+    box.extend(m * corner);
+  }
+
+  return box;
+}
+
+bool BoundingBox::intersect(const Point3D& eye, const Vector3D& invRay,
+                            const double tMin, const double tMax, double& tNear) const
+{
+  countStat(STAT_BOUNDS_TESTS);
+
+  double tFar = tMax;
+  tNear = tMin;
+
+  for (int i = 0; i < 3; i++) {
+    double t0 = (m_min[i] - eye[i]) * invRay[i];
+    double t1 = (m_max[i] - eye[i]) * invRay[i];
+    if (t0 > t1) {
+      std::swap(t0, t1);
+    }
+
+    // Written so that a NaN (eye on the slab of a parallel ray) counts as a hit.
+    if (t0 > tNear) tNear = t0;
+    if (t1 < tFar) tFar = t1;
+
+    if (tNear > tFar) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+int BoundingBox::intersect(const RayPacket& packet, const Lanes& tMin, const Lanes& tMax) const
+{
+  countStat(STAT_BOUNDS_TESTS, __builtin_popcount(packet.m_active));
+
+  Lanes tNear = tMin;
+  Lanes tFar = tMax;
+
+  // The single ray test without its early exit, so NaNs are treated the same way.
+  for (int i = 0; i < 3; i++) {
+    const Lanes t0 = (m_min[i] - packet.m_eye[i]) * packet.m_invRay[i];
+    const Lanes t1 = (m_max[i] - packet.m_eye[i]) * packet.m_invRay[i];
+    const LaneMask swapped = t0 > t1;
+    const Lanes tEnter = swapped ? t1 : t0;
+    const Lanes tLeave = swapped ? t0 : t1;
+
+    tNear = tEnter > tNear ? tEnter : tNear;
+    tFar = tLeave < tFar ? tLeave : tFar;
+  }
+
+  return laneBits(tNear <= tFar);
+}
+
+bool BoundingBox::intersectLine(const Point3D& eye, const Vector3D& ray,
+                                double& tNear, int& nearAxis, double& tFar, int& farAxis) const
+{
+  tNear = -DBL_MAX;
+  tFar = DBL_MAX;
+  nearAxis = farAxis = 0;
+
+  for (int i = 0; i < 3; i++) {
+    const double inv = 1.0 / ray[i];
+    const double t0 = (m_min[i] - eye[i]) * inv;
+    const double t1 = (m_max[i] - eye[i]) * inv;
+
+    // Ordered by the sign of the ray rather than comparing t0 and t1, so a NaN
+    // (eye on the slab of a parallel ray) is simply ignored by the selects below.
+    const double tEnter = inv < 0.0 ? t1 : t0;
+    const double tLeave = inv < 0.0 ? t0 : t1;
+
+    nearAxis = tEnter > tNear ? i : nearAxis;
+    tNear = tEnter > tNear ? tEnter : tNear;
+    farAxis = tLeave < tFar ? i : farAxis;
+    tFar = tLeave < tFar ? tLeave : tFar;
+  }
+
+  return tNear <= tFar;
+}
+
+bool BoundingBox::contains(const Point3D& p) const
+{
+  return p[0] >= m_min[0] && p[0] <= m_max[0] &&
+         p[1] >= m_min[1] && p[1] <= m_max[1] &&
+         p[2] >= m_min[2] && p[2] <= m_max[2];
+}
+
+Vector3D inverseRay(const Vector3D& ray)
+{
+  return Vector3D(1.0 / ray[0], 1.0 / ray[1], 1.0 / ray[2]);
+}
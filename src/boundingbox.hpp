@@ -0,0 +1,62 @@
+#ifndef BOUNDINGBOX_HPP
+#define BOUNDINGBOX_HPP
+
+#include "algebra.hpp"
+#include "packet.hpp"
+
+/*
+  An axis aligned bounding box.
+  A default constructed box is empty and grows as points are added to it.
+*/
+class BoundingBox {
+ public:
+  BoundingBox();
+  BoundingBox(const Point3D& min, const Point3D& max);
+
+  void extend(const Point3D& p);
+  void extend(const BoundingBox& other);
+
+  // Shrink the box to where it overlaps other, which may leave it empty.
+  void clip(const BoundingBox& other);
+
+  // Grow the box by amount in every direction.
+  void pad(const double amount);
+
+  bool isEmpty() const;
+  Point3D center() const;
+  double surfaceArea() const;
+  int longestAxis() const;
+
+  // Returns the box containing this box after it's been transformed by m.
+  BoundingBox transform(const Matrix4x4& m) const;
+
+  // Slab test. invRay holds the reciprocals of the ray's components.
+  // Returns true if the ray is inside the box somewhere in [tMin, tMax]
+  // and gives back the entry point (clamped to tMin) in tNear.
+  bool intersect(const Point3D& eye, const Vector3D& invRay,
+                 const double tMin, const double tMax, double& tNear) const;
+
+  // Slab test over the whole line, without branches.
+  // Gives back where the line enters and leaves the box and which axis the
+  // face crossed at each point is perpendicular to.
+  bool intersectLine(const Point3D& eye, const Vector3D& ray,
+                     double& tNear, int& nearAxis, double& tFar, int& farAxis) const;
+
+  // Slab test of every ray in the packet. Returns the lanes (one bit each)
+  // whose ray is inside the box somewhere in their [tMin, tMax].
+  int intersect(const RayPacket& packet, const Lanes& tMin, const Lanes& tMax) const;
+
+  bool contains(const Point3D& p) const;
+
+  const Point3D& min() const { return m_min; }
+  const Point3D& max() const { return m_max; }
+
+ private:
+  Point3D m_min;
+  Point3D m_max;
+};
+
+// Reciprocal of each component of the ray, used for repeated slab tests.
+Vector3D inverseRay(const Vector3D& ray);
+
+#endif
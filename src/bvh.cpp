@@ -0,0 +1,312 @@
+#include "bvh.hpp"
+#include "cache.hpp"
+#include "stats.hpp"
+#include <algorithm>
+#include <cfloat>
+
+static const int MAX_LEAF_SIZE = 4;
+static const int MAX_DEPTH = 60;
+static const int NUM_BINS = 12;
+
+// Relative cost of visiting a node compared to intersecting an item.
+static const double TRAVERSAL_COST = 0.5;
+
+// Maps the center of an item to one of the SAH bins along an axis.
+struct BinIndex {
+  BinIndex(const std::vector<Point3D>& centers, const BoundingBox& centerBox, const int axis)
+    : m_centers(centers), m_axis(axis), m_min(centerBox.min()[axis]),
+      m_scale(NUM_BINS / (centerBox.max()[axis] - centerBox.min()[axis]))
+  {}
+
+  int operator()(const int item) const {
+    int bin = (int)((m_centers[item][m_axis] - m_min) * m_scale);
+    return std::min(std::max(bin, 0), NUM_BINS - 1);
+  }
+
+  const std::vector<Point3D>& m_centers;
+  const int m_axis;
+  const double m_min;
+  const double m_scale;
+};
+
+// True for items that belong left of the split bin.
+struct LeftOfSplit {
+  LeftOfSplit(const BinIndex& binIndex, const int split)
+    : m_binIndex(binIndex), m_split(split)
+  {}
+
+  bool operator()(const int item) const {
+    return m_binIndex(item) < m_split;
+  }
+
+  const BinIndex& m_binIndex;
+  const int m_split;
+};
+
+BVH::BVH()
+  : m_nodes(), m_items()
+{
+}
+
+void BVH::build(const std::vector<BoundingBox>& bounds)
+{
+  m_nodes.clear();
+  m_items.clear();
+
+  if (bounds.empty()) {
+    return;
+  }
+
+  std::vector<Point3D> centers;
+  for (std::vector<BoundingBox>::const_iterator it = bounds.begin(); it != bounds.end(); it++) {
+    centers.push_back(it->center());
+    m_items.push_back(m_items.size());
+  }
+
+  m_nodes.reserve(2 * bounds.size());
+  m_nodes.push_back(Node());
+  buildNode(0, bounds, centers, 0, bounds.size(), 0);
+}
+
+void BVH::buildNode(const int nodeIndex, const std::vector<BoundingBox>& bounds,
+                    const std::vector<Point3D>& centers, const int first, const int count,
+                    const int depth)
+{
+  BoundingBox box;
+  BoundingBox centerBox;
+  for (int i = first; i < first + count; i++) {
+    box.extend(bounds[m_items[i]]);
+    centerBox.extend(centers[m_items[i]]);
+  }
+  m_nodes[nodeIndex].m_bounds = box;
+  m_nodes[nodeIndex].m_first = first;
+  m_nodes[nodeIndex].m_count = count;
+  m_nodes[nodeIndex].m_axis = 0;
+
+  if (count <= 1 || depth >= MAX_DEPTH) {
+    return;
+  }
+
+  int axis;
+  int mid = findSplit(bounds, centers, box, centerBox, first, count, axis);
+  if (mid < 0) {
+    return;
+  }
+
+  int left = m_nodes.size();
+  m_nodes.push_back(Node());
+  buildNode(left, bounds, centers, first, mid - first, depth + 1);
+
+  int right = m_nodes.size();
+  m_nodes.push_back(Node());
+  buildNode(right, bounds, centers, mid, first + count - mid, depth + 1);
+
+  m_nodes[nodeIndex].m_first = right;
+  m_nodes[nodeIndex].m_count = 0;
+  m_nodes[nodeIndex].m_axis = axis;
+}
+
+// Partitions the items using the binned surface area heuristic.
+// Returns the index of the first item in the right half or -1 if the
+// items are cheaper to leave in a single leaf.
+int BVH::findSplit(const std::vector<BoundingBox>& bounds, const std::vector<Point3D>& centers,
+                   const BoundingBox& box, const BoundingBox& centerBox,
+                   const int first, const int count, int& axis)
+{
+  double bestCost = DBL_MAX;
+  int bestAxis = -1;
+  int bestSplit = 0;
+
+  for (int a = 0; a < 3; a++) {
+    if (centerBox.max()[a] - centerBox.min()[a] < tightEpsilon) {
+      continue;
+    }
+
+    BinIndex binIndex(centers, centerBox, a);
+    BoundingBox binBounds[NUM_BINS];
+    int binCounts[NUM_BINS] = { 0 };
+    for (int i = first; i < first + count; i++) {
+      int bin = binIndex(m_items[i]);
+      binBounds[bin].extend(bounds[m_items[i]]);
+      binCounts[bin]++;
+    }
+
+    // Sweep from the right to get the cost of everything right of each split.
+    double rightArea[NUM_BINS];
+    int rightCount[NUM_BINS];
+    BoundingBox rightBox;
+    int total = 0;
+    for (int i = NUM_BINS - 1; i > 0; i--) {
+      rightBox.extend(binBounds[i]);
+      total += binCounts[i];
+      rightArea[i] = rightBox.surfaceArea();
+      rightCount[i] = total;
+    }
+
+    BoundingBox leftBox;
+    total = 0;
+    for (int i = 1; i < NUM_BINS; i++) {
+      leftBox.extend(binBounds[i - 1]);
+      total += binCounts[i - 1];
+      if (total == 0 || rightCount[i] == 0) {
+        continue;
+      }
+
+      double cost = leftBox.surfaceArea() * total + rightArea[i] * rightCount[i];
+      if (cost < bestCost) {
+        bestCost = cost;
+        bestAxis = a;
+        bestSplit = i;
+      }
+    }
+  }
+
+  if (bestAxis < 0) {
+    // All centers are in the same spot, so just split the items in half.
+    if (count <= MAX_LEAF_SIZE) {
+      return -1;
+    }
+    axis = 0;
+    return first + count / 2;
+  }
+
+  double area = box.surfaceArea();
+  double splitCost = TRAVERSAL_COST + (area > 0.0 ? bestCost / area : 0.0);
+  if (count <= MAX_LEAF_SIZE && splitCost >= count) {
+    return -1;
+  }
+
+  axis = bestAxis;
+  BinIndex binIndex(centers, centerBox, axis);
+  std::vector<int>::iterator mid = std::partition(m_items.begin() + first,
+                                                  m_items.begin() + first + count,
+                                                  LeftOfSplit(binIndex, bestSplit));
+
+  return mid - m_items.begin();
+}
+
+void BVH::traverse(const Point3D& eye, const Vector3D& ray, const double tMin, double tMax,
+                   Visitor& visitor) const
+{
+  if (m_nodes.empty()) {
+    return;
+  }
+
+  const Vector3D invRay = inverseRay(ray);
+
+  int stack[MAX_DEPTH + 2];
+  int stackSize = 0;
+  stack[stackSize++] = 0;
+
+  while (stackSize > 0) {
+    int index = stack[--stackSize];
+    const Node& node = m_nodes[index];
+    countStat(STAT_BVH_NODES);
+
+    double tNear;
+    if (!node.m_bounds.intersect(eye, invRay, tMin, tMax, tNear)) {
+      continue;
+    }
+
+    if (node.m_count > 0) {
+      for (int i = node.m_first; i < node.m_first + node.m_count; i++) {
+        if (visitor.visit(m_items[i], tMax)) {
+          return;
+        }
+      }
+    } else if (ray[node.m_axis] > 0) {
+      // Left child holds the smaller centers so it's nearer; push it last.
+      stack[stackSize++] = node.m_first;
+      stack[stackSize++] = index + 1;
+    } else {
+      stack[stackSize++] = index + 1;
+      stack[stackSize++] = node.m_first;
+    }
+  }
+}
+
+void BVH::traverse(const RayPacket& packet, const Lanes& tMin, Lanes& tMax,
+                   PacketVisitor& visitor) const
+{
+  if (m_nodes.empty()) {
+    return;
+  }
+
+  int stack[MAX_DEPTH + 2];
+  int stackSize = 0;
+  stack[stackSize++] = 0;
+
+  while (stackSize > 0) {
+    int index = stack[--stackSize];
+    const Node& node = m_nodes[index];
+    countStat(STAT_BVH_NODES);
+
+    const int lanes = node.m_bounds.intersect(packet, tMin, tMax) & packet.m_active;
+    if (!lanes) {
+      continue;
+    }
+
+    if (node.m_count > 0) {
+      for (int i = node.m_first; i < node.m_first + node.m_count; i++) {
+        visitor.visit(m_items[i], lanes, tMax);
+      }
+    } else if (packet.m_ray[node.m_axis][0] > 0) {
+      stack[stackSize++] = node.m_first;
+      stack[stackSize++] = index + 1;
+    } else {
+      stack[stackSize++] = index + 1;
+      stack[stackSize++] = node.m_first;
+    }
+  }
+}
+
+void BVH::traverse(const Point3D& p, Visitor& visitor) const
+{
+  if (m_nodes.empty()) {
+    return;
+  }
+
+  int stack[MAX_DEPTH + 2];
+  int stackSize = 0;
+  stack[stackSize++] = 0;
+
+  double unused = 0.0;
+  while (stackSize > 0) {
+    int index = stack[--stackSize];
+    const Node& node = m_nodes[index];
+    countStat(STAT_BVH_NODES);
+
+    if (!node.m_bounds.contains(p)) {
+      continue;
+    }
+
+    if (node.m_count > 0) {
+      for (int i = node.m_first; i < node.m_first + node.m_count; i++) {
+        if (visitor.visit(m_items[i], unused)) {
+          return;
+        }
+      }
+    } else {
+      stack[stackSize++] = node.m_first;
+      stack[stackSize++] = index + 1;
+    }
+  }
+}
+
+const BoundingBox& BVH::getBounds() const
+{
+  static const BoundingBox empty;
+
+  return m_nodes.empty() ? empty : m_nodes.front().m_bounds;
+}
+
+void BVH::write(CacheWriter& cache) const
+{
+  cache.write(m_nodes);
+  cache.write(m_items);
+}
+
+bool BVH::read(CacheReader& cache)
+{
+  return cache.read(m_nodes) && cache.read(m_items);
+}
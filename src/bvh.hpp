@@ -0,0 +1,87 @@
+#ifndef BVH_HPP
+#define BVH_HPP
+
+#include <vector>
+#include "algebra.hpp"
+#include "boundingbox.hpp"
+
+class CacheWriter;
+class CacheReader;
+
+/*
+  Bounding volume hierarchy over a set of items given by their bounding boxes.
+  The BVH only stores indices into the owner's list of items; the owner
+  intersects the items themselves through a Visitor.
+
+  The tree is built using the surface area heuristic and traversed nearest
+  node first, so visitors looking for the closest hit can prune the rest
+  of the traversal by shrinking tMax.
+*/
+class BVH {
+ public:
+  BVH();
+
+  class Visitor {
+   public:
+    virtual ~Visitor() {}
+
+    // Called for every item whose bounding box is hit by the ray.
+    // tMax is the furthest distance of interest along the ray and may be
+    // reduced by the visitor. Returning true ends the traversal.
+    virtual bool visit(const int item, double& tMax) = 0;
+  };
+
+  class PacketVisitor {
+   public:
+    virtual ~PacketVisitor() {}
+
+    // Called for every item whose bounding box is hit by a ray of the
+    // packet. lanes has a bit set for each ray that hits it, tMax is as
+    // for Visitor, one lane per ray.
+    virtual void visit(const int item, const int lanes, Lanes& tMax) = 0;
+  };
+
+  void build(const std::vector<BoundingBox>& bounds);
+
+  // Visits the items whose bounds are hit by the ray between tMin and tMax.
+  void traverse(const Point3D& eye, const Vector3D& ray, const double tMin, double tMax,
+                Visitor& visitor) const;
+
+  // Packet version of the above. Nodes are visited in the order that suits
+  // the packet's first ray, the others are assumed to point the same way.
+  void traverse(const RayPacket& packet, const Lanes& tMin, Lanes& tMax,
+                PacketVisitor& visitor) const;
+
+  // Visits the items whose bounds contain p.
+  void traverse(const Point3D& p, Visitor& visitor) const;
+
+  // Saves or restores a built hierarchy.
+  void write(CacheWriter& cache) const;
+  bool read(CacheReader& cache);
+
+  bool empty() const { return m_nodes.empty(); }
+  const BoundingBox& getBounds() const;
+
+ private:
+  // Leaves hold m_count items starting at m_items[m_first].
+  // Interior nodes have m_count == 0, their left child directly follows
+  // them and m_first is the index of their right child.
+  struct Node {
+    BoundingBox m_bounds;
+    int m_first;
+    int m_count;
+    int m_axis;
+  };
+
+  void buildNode(const int nodeIndex, const std::vector<BoundingBox>& bounds,
+                 const std::vector<Point3D>& centers, const int first, const int count,
+                 const int depth);
+  int findSplit(const std::vector<BoundingBox>& bounds, const std::vector<Point3D>& centers,
+                const BoundingBox& box, const BoundingBox& centerBox,
+                const int first, const int count, int& axis);
+
+  std::vector<Node> m_nodes;
+  std::vector<int> m_items;
+};
+
+#endif
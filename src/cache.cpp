@@ -0,0 +1,136 @@
+#include "cache.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+static const char CACHE_MAGIC[8] = { 'R', 'T', 'C', 'A', 'C', 'H', 'E', '\0' };
+
+uint64_t hashBytes(const char* data, const long size)
+{
+  // FNV-1a over whole words, with a shift so high bits reach the low ones.
+  const uint64_t prime = 1099511628211ULL;
+  uint64_t hash = 14695981039346656037ULL ^ (uint64_t)size;
+
+  long i = 0;
+  for (; i + 8 <= size; i += 8) {
+    uint64_t word;
+    memcpy(&word, data + i, 8);
+    hash = (hash ^ word) * prime;
+    hash ^= hash >> 32;
+  }
+  for (; i < size; i++) {
+    hash = (hash ^ (unsigned char)data[i]) * prime;
+  }
+
+  return hash;
+}
+
+/* *** MappedFile *** */
+
+MappedFile::MappedFile()
+  : m_data(NULL), m_size(0)
+{}
+
+MappedFile::~MappedFile()
+{
+  if (m_data) {
+    munmap((void*)m_data, m_size);
+  }
+}
+
+bool MappedFile::open(const std::string& filename)
+{
+  int fd = ::open(filename.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return false;
+  }
+
+  struct stat info;
+  if (fstat(fd, &info) != 0) {
+    close(fd);
+    return false;
+  }
+
+  if (info.st_size > 0) {
+    void* map = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (map == MAP_FAILED) {
+      close(fd);
+      return false;
+    }
+    m_data = (const char*)map;
+    m_size = info.st_size;
+  }
+
+  close(fd);
+  return true;
+}
+
+/* *** CacheWriter *** */
+
+CacheWriter::CacheWriter(const std::string& filename, const uint64_t key)
+  : m_filename(filename),
+    m_tmpName(),
+    m_out()
+{
+  // A temporary file of our own next to the cache, so runs writing the same
+  // cache at once never write into each other's files.
+  std::vector<char> tmpName(filename.begin(), filename.end());
+  const char suffix[] = ".XXXXXX";
+  tmpName.insert(tmpName.end(), suffix, suffix + sizeof(suffix));
+  int fd = mkstemp(&tmpName[0]);
+  if (fd >= 0) {
+    // mkstemp makes the file private, but caches are shared like any other file.
+    mode_t mask = umask(0);
+    umask(mask);
+    fchmod(fd, 0666 & ~mask);
+    ::close(fd);
+
+    m_tmpName = &tmpName[0];
+    m_out.open(m_tmpName.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+  } else {
+    m_out.setstate(std::ios::failbit);
+  }
+
+  m_out.write(CACHE_MAGIC, sizeof(CACHE_MAGIC));
+  write(CACHE_VERSION);
+  write(key);
+}
+
+bool CacheWriter::close()
+{
+  m_out.close();
+
+  // Renaming means other runs never see a half written cache.
+  if (m_out.fail() || rename(m_tmpName.c_str(), m_filename.c_str()) != 0) {
+    if (!m_tmpName.empty()) {
+      remove(m_tmpName.c_str());
+    }
+    return false;
+  }
+
+  return true;
+}
+
+/* *** CacheReader *** */
+
+CacheReader::CacheReader(const std::string& filename, const uint64_t key)
+  : m_file(), m_pos(NULL), m_end(NULL)
+{
+  if (!m_file.open(filename) || m_file.size() < (long)sizeof(CACHE_MAGIC)) {
+    return;
+  }
+
+  m_pos = m_file.data() + sizeof(CACHE_MAGIC);
+  m_end = m_file.data() + m_file.size();
+
+  uint32_t version;
+  uint64_t cacheKey;
+  if (memcmp(m_file.data(), CACHE_MAGIC, sizeof(CACHE_MAGIC)) != 0 ||
+      !read(version) || version != CACHE_VERSION ||
+      !read(cacheKey) || cacheKey != key) {
+    m_pos = m_end = NULL;
+  }
+}
@@ -0,0 +1,118 @@
+#ifndef CACHE_HPP
+#define CACHE_HPP
+
+#include <stdint.h>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+/*
+  Binary caches of data that is slow to build, like loaded meshes.
+
+  A cache starts with a format version and a key naming what it was built
+  from, followed by values and arrays copied byte for byte. Caches are only
+  read back by the build that wrote them, so anything written with another
+  version, key or record size is treated as missing.
+*/
+
+// Bump whenever the contents of a cached structure change.
+static const uint32_t CACHE_VERSION = 2;
+
+// Quick 64 bit hash of a block of memory, used to key caches on their source.
+uint64_t hashBytes(const char* data, const long size);
+
+// A read only memory map of a whole file.
+class MappedFile {
+ public:
+  MappedFile();
+  ~MappedFile();
+
+  // Sets errno on failure. An empty file maps to no data.
+  bool open(const std::string& filename);
+
+  const char* data() const { return m_data; }
+  long size() const { return m_size; }
+
+ private:
+  MappedFile(const MappedFile&);
+  MappedFile& operator=(const MappedFile&);
+
+  const char* m_data;
+  long m_size;
+};
+
+class CacheWriter {
+ public:
+  CacheWriter(const std::string& filename, const uint64_t key);
+
+  template <typename T>
+  void write(const T& value)
+  {
+    m_out.write((const char*)&value, sizeof(T));
+  }
+
+  template <typename T>
+  void write(const std::vector<T>& values)
+  {
+    write((uint64_t)values.size());
+    write((uint32_t)sizeof(T));
+    if (!values.empty()) {
+      m_out.write((const char*)&values[0], values.size() * sizeof(T));
+    }
+  }
+
+  // Moves the finished cache into place. Returns false if any write failed.
+  bool close();
+
+ private:
+  std::string m_filename;
+  std::string m_tmpName;
+  std::ofstream m_out;
+};
+
+class CacheReader {
+ public:
+  CacheReader(const std::string& filename, const uint64_t key);
+
+  // Whether the cache exists and was built from the given key.
+  bool ok() const { return m_pos != NULL; }
+
+  // Whether everything in the cache has been read.
+  bool done() const { return m_pos == m_end; }
+
+  template <typename T>
+  bool read(T& value)
+  {
+    if (!m_pos || m_end - m_pos < (long)sizeof(T)) {
+      return false;
+    }
+    memcpy((char*)&value, m_pos, sizeof(T));
+    m_pos += sizeof(T);
+    return true;
+  }
+
+  template <typename T>
+  bool read(std::vector<T>& values)
+  {
+    uint64_t count;
+    uint32_t size;
+    if (!read(count) || !read(size) || size != sizeof(T) ||
+        count > (uint64_t)(m_end - m_pos) / sizeof(T)) {
+      return false;
+    }
+    values.resize(count);
+    if (count > 0) {
+      memcpy((char*)&values[0], m_pos, count * sizeof(T));
+    }
+    m_pos += count * sizeof(T);
+    return true;
+  }
+
+ private:
+  MappedFile m_file;
+  const char* m_pos;
+  const char* m_end;
+};
+
+#endif
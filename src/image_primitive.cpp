@@ -1,4 +1,5 @@
 #include "image_primitive.hpp"
+#include "stats.hpp"
 #include <vector>
 
 ImagePrimitive::ImagePrimitive(const int copies)
@@ -14,15 +15,17 @@ ImagePrimitive::ImagePrimitive(const int copies)
 }
 
 bool ImagePrimitive::filteredIntersect(const Point3D& eye, const Vector3D& ray, 
-                                 std::list<IntersectionPoint>& tVals) const
+                                 HitList& tVals) const
 {
   // No need to filter here
   return intersect(eye, ray,  tVals);
 }
 
 bool ImagePrimitive::intersect(const Point3D& eye, const Vector3D& ray, 
-                         std::list<IntersectionPoint>& tVals) const
+                         HitList& tVals) const
 {
+  countStat(STAT_IMAGE_TESTS);
+
   if (m_face.intersect(eye, ray,  tVals)) {
     // We want the normal to always be pointing towards the eye
     if (m_face.checkConstraint(eye)) {
@@ -58,29 +61,7 @@ Vector3D ImagePrimitive::getNormal(const Point3D& p) const
   return m_face.getNormal(p);
 }
 
-Mesh* ImagePrimitive::getBoundingBox() const
+BoundingBox ImagePrimitive::getBounds() const
 {
-  Point3D pos(0.0, 0.0, 0.0);
-  double size = 1.0;
-
-  std::vector<Point3D> vertices;
-  vertices.push_back(Point3D(pos[0], pos[1], pos[2]));
-  vertices.push_back(Point3D(pos[0] + size, pos[1], pos[2]));
-  vertices.push_back(Point3D(pos[0] + size, pos[1] + size, pos[2]));
-  vertices.push_back(Point3D(pos[0], pos[1] + size, pos[2]));
-  vertices.push_back(Point3D(pos[0], pos[1], pos[2]));
-  vertices.push_back(Point3D(pos[0] + size, pos[1], pos[2]));
-  vertices.push_back(Point3D(pos[0] + size, pos[1] + size, pos[2]));
-  vertices.push_back(Point3D(pos[0], pos[1] + size, pos[2]));
-
-  std::vector<std::vector<int> > f;
-  int faces[6][4] = { {3, 2, 1, 0}, // Front
-                      {0, 1, 5, 4}, // Bottom
-                      {2, 6, 5, 1}, // Right
-                      {7, 3, 0, 4}, // Left
-                      {7, 6, 2, 3}, // Top
-                      {4, 5, 6, 7}}; // Back
-  for (int i = 0; i < 6; i++) f.push_back(std::vector<int> (faces[i], faces[i] + 4));
-
-  return new Mesh(vertices, f);
+  return BoundingBox(Point3D(0.0, 0.0, 0.0), Point3D(m_copies, m_copies, 0.0));
 }
@@ -8,14 +8,14 @@ class ImagePrimitive : public Primitive {
   ImagePrimitive(const int copies = 1);
 
   bool filteredIntersect(const Point3D& eye, const Vector3D& ray,
-                                 std::list<IntersectionPoint>& tVals) const;
+                                 HitList& tVals) const;
   bool intersect(const Point3D& eye, const Vector3D& ray,
-                         std::list<IntersectionPoint>& tVals) const;
+                         HitList& tVals) const;
   bool containsPoint(const Point3D& p) const;
   Point2D textureMapCoords(const Point3D& p) const;
   Vector3D getNormal(const Point3D& p) const;
 
-  Mesh* getBoundingBox() const;
+  BoundingBox getBounds() const;
  private:
   Polygon m_face;
   int m_copies;
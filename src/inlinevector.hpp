@@ -0,0 +1,116 @@
+#ifndef INLINEVECTOR_HPP
+#define INLINEVECTOR_HPP
+
+#include <algorithm>
+
+/*
+  A vector that keeps its first N elements inside the object itself and
+  only goes to the heap once it outgrows them.
+  Intersection results are built and thrown away for every ray, so keeping
+  them on the stack stops the render threads from fighting over malloc.
+  T must be default constructible and assignable.
+*/
+template <typename T, int N>
+class InlineVector {
+ public:
+  typedef T* iterator;
+  typedef const T* const_iterator;
+
+  InlineVector() :
+    m_data(m_inline), m_size(0), m_capacity(N)
+  {}
+
+  InlineVector(const InlineVector& other) :
+    m_data(m_inline), m_size(0), m_capacity(N)
+  {
+    *this = other;
+  }
+
+  ~InlineVector()
+  {
+    if (m_data != m_inline) {
+      delete [] m_data;
+    }
+  }
+
+  InlineVector& operator=(const InlineVector& other)
+  {
+    if (this != &other) {
+      m_size = 0;
+      reserve(other.m_size);
+      std::copy(other.begin(), other.end(), m_data);
+      m_size = other.m_size;
+    }
+    return *this;
+  }
+
+  void push_back(const T& value)
+  {
+    if (m_size == m_capacity) {
+      // value may live in our own storage.
+      T copy = value;
+      reserve(2 * m_capacity);
+      m_data[m_size++] = copy;
+    } else {
+      m_data[m_size++] = value;
+    }
+  }
+
+  // Removes the element at pos, keeping the order of the rest.
+  iterator erase(iterator pos)
+  {
+    std::copy(pos + 1, end(), pos);
+    m_size--;
+    return pos;
+  }
+
+  // New elements past the old size are left default constructed or stale.
+  void resize(const int size)
+  {
+    reserve(size);
+    m_size = size;
+  }
+
+  void clear() { m_size = 0; }
+
+  void sort() { std::sort(begin(), end()); }
+
+  int size() const { return m_size; }
+  bool empty() const { return m_size == 0; }
+
+  iterator begin() { return m_data; }
+  iterator end() { return m_data + m_size; }
+  const_iterator begin() const { return m_data; }
+  const_iterator end() const { return m_data + m_size; }
+
+  T& front() { return m_data[0]; }
+  const T& front() const { return m_data[0]; }
+  T& back() { return m_data[m_size - 1]; }
+  const T& back() const { return m_data[m_size - 1]; }
+
+  T& operator[](const int i) { return m_data[i]; }
+  const T& operator[](const int i) const { return m_data[i]; }
+
+ private:
+  void reserve(const int capacity)
+  {
+    if (capacity <= m_capacity) {
+      return;
+    }
+
+    T* data = new T[capacity];
+    std::copy(begin(), end(), data);
+    if (m_data != m_inline) {
+      delete [] m_data;
+    }
+    m_data = data;
+    m_capacity = capacity;
+  }
+
+  T m_inline[N];
+  T* m_data;
+  int m_size;
+  int m_capacity;
+};
+
+#endif
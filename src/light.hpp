@@ -13,6 +13,9 @@ struct Light {
   double falloff[3];
 };
 
+// The lights reaching a point being shaded.
+typedef InlineVector<Light*, 8> LightList;
+
 std::ostream& operator<<(std::ostream& out, const Light& l);
 
 #endif
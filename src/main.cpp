@@ -2,38 +2,162 @@
 #include "scene.hpp"
 #include "scene_lua.hpp"
 #include "renderer.hpp"
+#include "cache.hpp"
+#include "stats.hpp"
 
 int main(int argc, char** argv)
 { 
   std::string filename = argv[argc - 1];
   std::string outfile = filename.substr(0, filename.find_first_of('.')).append(".png");
 
+  int numCores = 1;
+  bool deterministic = false;
+  bool stochastic = false;
+  bool adaptive = false;
+  bool progressive = false;
+  int maxPasses = 0;
+  double interval = 60.0;
+  double timeLimit = 0.0;
+  long rayBudget = 0;
+  std::string statsFormat;
+  std::string heatmapMetric;
+  int numSamples = 0;
+  int maxSamples = 64;
+  double threshold = 0.01;
+  std::string sampleCountFile;
+  std::string samplerName = "stratified";
+  if (argc >= 3) {
+    for (int i = 1; i < argc - 1; i++) {
+      if (std::string(argv[i]) == "-s") {
+        stochastic = true;
+      } else if (std::string(argv[i]) == "-c") {
+        numCores = atoi(argv[i+1]);
+      } else if (std::string(argv[i]) == "-d") {
+        deterministic = true;
+      } else if (std::string(argv[i]) == "-n") {
+        numSamples = atoi(argv[i+1]);
+      } else if (std::string(argv[i]) == "-p") {
+        samplerName = argv[i+1];
+      } else if (std::string(argv[i]) == "-a") {
+        adaptive = true;
+      } else if (std::string(argv[i]) == "-m") {
+        maxSamples = atoi(argv[i+1]);
+      } else if (std::string(argv[i]) == "-t") {
+        threshold = atof(argv[i+1]);
+      } else if (std::string(argv[i]) == "-w") {
+        sampleCountFile = argv[i+1];
+      } else if (std::string(argv[i]) == "-r") {
+        progressive = true;
+        maxPasses = atoi(argv[i+1]);
+      } else if (std::string(argv[i]) == "-i") {
+        interval = atof(argv[i+1]);
+      } else if (std::string(argv[i]) == "--time-limit") {
+        timeLimit = atof(argv[i+1]);
+      } else if (std::string(argv[i]) == "--ray-budget") {
+        // Through atof so budgets like 1e9 work.
+        rayBudget = (long)atof(argv[i+1]);
+      } else if (std::string(argv[i]) == "--stats") {
+        statsFormat = argv[i+1];
+      } else if (std::string(argv[i]) == "--heatmap") {
+        heatmapMetric = argv[i+1];
+      }
+    }
+  }
+
+  if (!statsFormat.empty()) {
+    if (statsFormat != "table" && statsFormat != "json") {
+      std::cerr << "Unknown stats format " << statsFormat << std::endl;
+      return 1;
+    }
+    enableStats();
+  }
+
+  CostMetric costMetric = COST_NONE;
+  if (heatmapMetric == "time") {
+    costMetric = COST_TIME;
+  } else if (heatmapMetric == "tests") {
+    costMetric = COST_TESTS;
+  } else if (!heatmapMetric.empty()) {
+    std::cerr << "Unknown heatmap metric " << heatmapMetric << std::endl;
+    return 1;
+  }
+
+  // Budgets are spent one pass at a time, so samples stay spread evenly over the image.
+  const bool budgeted = timeLimit > 0.0 || rayBudget > 0;
+  if (budgeted && adaptive) {
+    std::cerr << "--time-limit and --ray-budget can't be used with adaptive sampling (-a)"
+              << std::endl;
+    return 1;
+  }
+
+  startPhase(PHASE_LOAD);
   Scene* scene = import_lua(filename);
   if (!scene) {
     std::cerr << "Could not open " << filename << std::endl;
     return 1;
   }
+  endPhase(PHASE_LOAD);
 
-  Renderer* renderer = NULL;
-  if (scene->hasFocalPlane()) {
-    renderer = new DepthOfFieldRenderer(scene, scene->getFocalPlanePoint());  
+  if (budgeted) {
+    if (scene->hasFocalPlane()) {
+      std::cerr << "--time-limit and --ray-budget can't be used with a focal point" << std::endl;
+      return 1;
+    }
+    progressive = true;
   }
-  int numCores = 1;
-  if (argc >= 3) {
-    for (int i = 1; i < argc - 1; i++) {
-      if (std::string(argv[i]) == "-s" && !renderer) {
-        renderer = new StochasticRenderer(scene);
-      } else if (std::string(argv[i]) == "-c") {
-        numCores = atoi(argv[i+1]);
+
+  startPhase(PHASE_BUILD);
+  scene->build();
+  endPhase(PHASE_BUILD);
+
+  Renderer* renderer = NULL;
+  if (scene->hasFocalPlane() || stochastic || adaptive || progressive) {
+    if (numSamples <= 0) {
+      if (scene->hasFocalPlane()) {
+        numSamples = 10;
+      } else {
+        numSamples = (adaptive || progressive) ? 4 : 16;
       }
     }
-  }
 
-  if (renderer == NULL) {
+    Sampler* sampler = createSampler(samplerName, numSamples);
+    if (!sampler) {
+      std::cerr << "Unknown sampler " << samplerName << std::endl;
+      return 1;
+    }
+
+    if (scene->hasFocalPlane()) {
+      renderer = new DepthOfFieldRenderer(scene, scene->getFocalPlanePoint(), sampler);
+    } else if (progressive) {
+      // Checkpoints are only resumed by renders of the same script and sampler.
+      std::string key = samplerName;
+      MappedFile script;
+      if (script.open(filename)) {
+        key.append(script.data(), script.size());
+      }
+      std::string checkpointFile = filename.substr(0, filename.find_first_of('.')).append(".checkpoint");
+      ProgressiveRenderer* progressiveRenderer =
+        new ProgressiveRenderer(scene, sampler, maxPasses, interval, checkpointFile,
+                                hashBytes(key.data(), key.size()));
+      progressiveRenderer->setBudget(timeLimit, rayBudget);
+      renderer = progressiveRenderer;
+    } else if (adaptive) {
+      renderer = new AdaptiveRenderer(scene, sampler, maxSamples, threshold, sampleCountFile);
+    } else {
+      renderer = new StochasticRenderer(scene, sampler);
+    }
+  } else {
     renderer = new BasicRenderer(scene);
   }
+  renderer->setDeterministic(deterministic);
+  if (costMetric != COST_NONE) {
+    renderer->setCostHeatmap(costMetric, filename.substr(0, filename.find_first_of('.')).append("-cost.png"));
+  }
 
   renderer->render(outfile, numCores);
   delete renderer;
-}
 
+  if (!statsFormat.empty()) {
+    reportStats(statsFormat);
+  }
+}
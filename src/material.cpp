@@ -24,7 +24,7 @@ void PhongMaterial::bump(const std::string& filename)
 }
 
 Colour PhongMaterial::getColour(const Vector3D& normal, const Vector3D& viewDirection,
-                                const std::list<Light*>& lights, const Colour& ambient, 
+                                const LightList& lights, const Colour& ambient, 
                                 const Point3D& poi, const Primitive* primitive) const
 {
   // Get diffuse coefficients
@@ -33,7 +33,7 @@ Colour PhongMaterial::getColour(const Vector3D& normal, const Vector3D& viewDire
   // First add ambient light.
   Colour c = kd * ambient;
 
-  for (std::list<Light*>::const_iterator it = lights.begin(); it != lights.end(); it++) {
+  for (LightList::const_iterator it = lights.begin(); it != lights.end(); it++) {
     Light* light = (*it);
 
     Vector3D lightDirection = light->position - poi; // Note this needs to point towards the light.
@@ -3,10 +3,9 @@
 
 #include "algebra.hpp"
 #include "image.hpp"
-#include <list>
+#include "light.hpp"
 
 class Primitive;
-class Light;
 
 class PhongMaterial {
  public:
@@ -15,7 +14,7 @@ class PhongMaterial {
   virtual ~PhongMaterial();
 
   Colour getColour(const Vector3D& normal, const Vector3D& viewDirection,
-                   const std::list<Light*>& lights, const Colour& ambient,
+                   const LightList& lights, const Colour& ambient,
                    const Point3D& poi, const Primitive* primitive) const;
 
   void bump(const std::string& filename);
@@ -23,6 +22,8 @@ class PhongMaterial {
   // Texture mapped images might have an alpha channel
   // So we should avoid hits where this is the case.
   virtual bool hasZeroAlpha(const Primitive* primitive, const Point3D& p) const = 0;
+  // False if hasZeroAlpha is always false.
+  virtual bool hasAlpha() const { return false; }
 
   const double m_transparency;
   const double m_refractiveIndex;
@@ -62,6 +63,7 @@ class TextureMap : public PhongMaterial {
   virtual ~TextureMap();
 
   bool hasZeroAlpha(const Primitive* primitive, const Point3D& p) const;
+  bool hasAlpha() const { return m_textureMap.elements() >= 4; }
 
  protected:
   Colour getDiffuse(const Primitive* primitive, const Point3D& p) const;
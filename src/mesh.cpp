@@ -1,94 +1,481 @@
 #include "primitive.hpp"
+#include "cache.hpp"
+#include "stats.hpp"
 #include <iostream>
 #include <cfloat>
+#include <algorithm>
+#include <pthread.h>
+#include <unistd.h>
+
+/*
+  Visitor collecting every triangle intersection along the ray.
+*/
+class TriangleCollector : public BVH::Visitor {
+ public:
+  TriangleCollector(const std::vector<Point3D>& verts, const std::vector<Vector3D>& normals,
+                    const std::vector<Triangle>& triangles, const ShearedRay& ray, HitList& tVals)
+    : m_verts(verts), m_normals(normals), m_triangles(triangles), m_ray(ray), m_tVals(tVals)
+  {}
+
+  bool visit(const int item, double& tMax) {
+    (void)tMax;
+
+    double t, bary[3];
+    if (m_triangles[item].intersect(m_verts, m_ray, t, bary)) {
+      m_tVals.push_back(IntersectionPoint(t, m_triangles[item].getNormal(m_normals, bary)));
+    }
+    return false;
+  }
+
+ private:
+  const std::vector<Point3D>& m_verts;
+  const std::vector<Vector3D>& m_normals;
+  const std::vector<Triangle>& m_triangles;
+  const ShearedRay& m_ray;
+  HitList& m_tVals;
+};
+
+/*
+  TriangleCollector for each ray of a packet set in lanes.
+*/
+class TrianglePacketCollector : public BVH::PacketVisitor {
+ public:
+  TrianglePacketCollector(const std::vector<Point3D>& verts, const std::vector<Vector3D>& normals,
+                          const std::vector<Triangle>& triangles, const ShearedPacket& ray,
+                          const int lanes, HitList hits[])
+    : m_verts(verts), m_normals(normals), m_triangles(triangles), m_ray(ray), m_lanes(lanes),
+      m_hits(hits)
+  {}
+
+  void visit(const int item, const int lanes, Lanes& tMax) {
+    (void)tMax;
+
+    const Triangle& triangle = m_triangles[item];
+    Lanes t, bary[3];
+    const int hit = triangle.intersect(m_verts, m_ray, lanes & m_lanes, t, bary);
+    for (int i = 0; hit && i < PACKET_SIZE; i++) {
+      if (hit & (1 << i)) {
+        const double weights[3] = { bary[0][i], bary[1][i], bary[2][i] };
+        m_hits[i].push_back(IntersectionPoint(t[i], triangle.getNormal(m_normals, weights)));
+      }
+    }
+  }
+
+ private:
+  const std::vector<Point3D>& m_verts;
+  const std::vector<Vector3D>& m_normals;
+  const std::vector<Triangle>& m_triangles;
+  const ShearedPacket& m_ray;
+  const int m_lanes;
+  HitList* m_hits;
+};
+
+/*
+  Visitor keeping only the closest triangle intersection in front of the eye.
+*/
+class ClosestTriangle : public BVH::Visitor {
+ public:
+  ClosestTriangle(const std::vector<Point3D>& verts, const std::vector<Triangle>& triangles,
+                  const ShearedRay& ray)
+    : m_minT(DBL_MAX), m_verts(verts), m_triangles(triangles), m_ray(ray)
+  {}
+
+  bool visit(const int item, double& tMax) {
+    double t, bary[3];
+    if (m_triangles[item].intersect(m_verts, m_ray, t, bary)) {
+      if (t >= 0.0 && t < m_minT) {
+        m_minT = tMax = t;
+      }
+    }
+    return false;
+  }
+
+  double m_minT;
+
+ private:
+  const std::vector<Point3D>& m_verts;
+  const std::vector<Triangle>& m_triangles;
+  const ShearedRay& m_ray;
+};
+
+/*
+  Visitor stopping at the first triangle crossed in the traversal's range.
+*/
+class AnyTriangle : public BVH::Visitor {
+ public:
+  AnyTriangle(const std::vector<Point3D>& verts, const std::vector<Triangle>& triangles,
+              const ShearedRay& ray, const double tMin)
+    : m_found(false), m_verts(verts), m_triangles(triangles), m_ray(ray), m_tMin(tMin)
+  {}
+
+  bool visit(const int item, double& tMax) {
+    double t, bary[3];
+    m_found = m_triangles[item].intersect(m_verts, m_ray, t, bary) && t > m_tMin && t < tMax;
+    return m_found;
+  }
+
+  bool m_found;
+
+ private:
+  const std::vector<Point3D>& m_verts;
+  const std::vector<Triangle>& m_triangles;
+  const ShearedRay& m_ray;
+  const double m_tMin;
+};
+
+/*
+  Visitor finding the triangle a point lies on.
+*/
+class TriangleFinder : public BVH::Visitor {
+ public:
+  TriangleFinder(const std::vector<Point3D>& verts, const std::vector<Triangle>& triangles,
+                 const Point3D& p)
+    : m_found(-1), m_verts(verts), m_triangles(triangles), m_p(p)
+  {}
+
+  bool visit(const int item, double& tMax) {
+    (void)tMax;
+
+    if (m_triangles[item].intersect(m_verts, m_p)) {
+      // Keep the first triangle in the list to match a linear search.
+      if (m_found < 0 || item < m_found) {
+        m_found = item;
+      }
+    }
+    return false;
+  }
+
+  int m_found;
+
+ private:
+  const std::vector<Point3D>& m_verts;
+  const std::vector<Triangle>& m_triangles;
+  const Point3D& m_p;
+};
+
+// Vertices worth giving their own thread when bounding a mesh.
+static const long MIN_VERTS_PER_THREAD = 1 << 16;
+
+/*
+  A run of vertices searched by one thread for the one farthest from a point.
+*/
+struct FarthestSearch {
+  const Point3D* m_begin;
+  const Point3D* m_end;
+  Point3D m_from;
+
+  const Point3D* m_farthest;
+  double m_dist2;
+};
+
+static void* searchFarthest(void* arg)
+{
+  FarthestSearch* search = (FarthestSearch*)arg;
+
+  search->m_farthest = search->m_begin;
+  search->m_dist2 = -1.0;
+  for (const Point3D* p = search->m_begin; p != search->m_end; p++) {
+    const double dist2 = (*p - search->m_from).length2();
+    if (dist2 > search->m_dist2) {
+      search->m_farthest = p;
+      search->m_dist2 = dist2;
+    }
+  }
+
+  return NULL;
+}
+
+// Finds the vertex farthest from a point, searching big meshes in parallel.
+// Ties go to the first such vertex however the search is split.
+static const Point3D& farthestVertex(const std::vector<Point3D>& verts, const Point3D& from)
+{
+  long numThreads = std::min(sysconf(_SC_NPROCESSORS_ONLN),
+                             (long)verts.size() / MIN_VERTS_PER_THREAD + 1);
+  if (numThreads < 1) {
+    numThreads = 1;
+  }
+
+  std::vector<FarthestSearch> searches(numThreads);
+  std::vector<pthread_t> threads(numThreads);
+  for (long i = 0; i < numThreads; i++) {
+    searches[i].m_begin = &verts[0] + verts.size() * i / numThreads;
+    searches[i].m_end = &verts[0] + verts.size() * (i + 1) / numThreads;
+    searches[i].m_from = from;
+  }
+
+  for (long i = 1; i < numThreads; i++) {
+    pthread_create(&threads[i], NULL, searchFarthest, &searches[i]);
+  }
+  searchFarthest(&searches[0]);
+
+  const FarthestSearch* farthest = &searches[0];
+  for (long i = 1; i < numThreads; i++) {
+    pthread_join(threads[i], NULL);
+    if (searches[i].m_dist2 > farthest->m_dist2) {
+      farthest = &searches[i];
+    }
+  }
+
+  return *farthest->m_farthest;
+}
 
 Mesh::Mesh()
   : m_verts(),
-    m_polygons(), 
+    m_triangles(),
+    m_faces(),
+    m_bvh(),
     m_boundingSphere(Point3D(0.0, 0.0, 0.0), 0.0)
 {}
 
 Mesh::Mesh(const std::vector<Point3D>& verts,
-           const std::vector< std::vector<int> >& faces,
-           const std::vector<Vector3D>& upVectors)
+           const std::vector< std::vector<int> >& faces)
   : m_verts(verts),
-    m_polygons(),
+    m_normals(),
+    m_uvs(),
+    m_triangles(),
+    m_faces(),
+    m_bvh(),
     m_boundingSphere(Point3D(0.0, 0.0, 0.0), 0.0)
 {
-  for (std::vector<Face>::const_iterator it = faces.begin(); it != faces.end(); it++) {
-    Vector3D v1 = verts[it->at(0)] - verts[it->at(1)];
-    Vector3D v2 = verts[it->at(2)] - verts[it->at(1)];
-    Vector3D normal = v2.cross(v1); 
-    
-    std::vector<Point3D> vertices;
-    for (Face::const_iterator it2 = it->begin(); it2 != it->end(); it2++) {
-      vertices.push_back(verts[*it2]);
+  addFaces(faces, std::vector<Face>(), std::vector<Face>());
+  buildBVH();
+  buildBoundingSphere();
+}
+
+Mesh::Mesh(const std::vector<Point3D>& verts, const std::vector<Face>& faces,
+           const std::vector<Vector3D>& normals, const std::vector<Face>& normalFaces,
+           const std::vector<Point2D>& uvs, const std::vector<Face>& uvFaces)
+  : m_verts(verts),
+    m_normals(normals),
+    m_uvs(uvs),
+    m_triangles(),
+    m_faces(),
+    m_bvh(),
+    m_boundingSphere(Point3D(0.0, 0.0, 0.0), 0.0)
+{
+  addFaces(faces, normalFaces, uvFaces);
+  buildBVH();
+  buildBoundingSphere();
+}
+
+void Mesh::addFaces(const std::vector<Face>& faces, const std::vector<Face>& normalFaces,
+                    const std::vector<Face>& uvFaces)
+{
+  for (unsigned int f = 0; f < faces.size(); f++) {
+    const Face& face = faces[f];
+    if (face.size() < 3) {
+      continue;
     }
 
-    // Just put something on the plane for the up vector.
-    m_polygons.push_back(Polygon(vertices, normal, v1));
+    const int frame = m_faces.size();
+    const Face* normalFace = f < normalFaces.size() && !normalFaces[f].empty() ? &normalFaces[f] : NULL;
+    const Face* uvFace = f < uvFaces.size() && !uvFaces[f].empty() ? &uvFaces[f] : NULL;
+
+    m_faces.push_back(FaceFrame(m_verts, face));
+
+    // Faces are convex, so a fan around the first vertex covers them.
+    for (unsigned int i = 1; i + 1 < face.size(); i++) {
+      Triangle triangle(m_verts, face[0], face[i], face[i + 1], frame);
+      const unsigned int corners[3] = { 0, i, i + 1 };
+      for (int j = 0; j < 3; j++) {
+        if (normalFace) triangle.m_n[j] = normalFace->at(corners[j]);
+        if (uvFace) triangle.m_uv[j] = uvFace->at(corners[j]);
+      }
+      m_triangles.push_back(triangle);
+    }
   }
+}
 
-  // If we're given up vectors add them to the polygons.
-  if (!upVectors.empty()) {
-    std::vector<Polygon>::iterator p = m_polygons.begin();
-    std::vector<Vector3D>::const_iterator it = upVectors.begin();
-    for ( ; p != m_polygons.end() && it != upVectors.end(); it++, p++) {
-      p->set_upVector(*it);
+void Mesh::buildBoundingSphere()
+{
+  if (m_verts.empty()) {
+    return;
+  }
+
+  // Ritter's sphere: start with two vertices that are far apart as the
+  // diameter, then grow the sphere to take in any vertex left outside.
+  const Point3D& a = farthestVertex(m_verts, m_verts.front());
+  const Point3D& b = farthestVertex(m_verts, a);
+  Point3D center = (1.0/2.0) * (a + b);
+  double radius = (b - a).length() / 2.0;
+
+  for (std::vector<Point3D>::const_iterator p = m_verts.begin(); p != m_verts.end(); p++) {
+    const double dist = (*p - center).length();
+    if (dist > radius) {
+      const double newRadius = (radius + dist) / 2.0;
+      center = center + ((dist - newRadius) / dist) * (*p - center);
+      radius = newRadius;
     }
   }
 
-  // Now create our bounding sphere
-  // Idea is to find max distance between two points.
-  // TODO: I don't think this is right....
-  double maxDist = 0.0;
-  Point3D point1, point2;
-  for (std::vector<Point3D>::const_iterator p1 = verts.begin(); p1 != verts.end(); p1++) {
-    for (std::vector<Point3D>::const_iterator p2 = p1 + 1; p2 != verts.end(); p2++) {
-      double dist = (*p1 - *p2).length();
-      if (dist > maxDist) {
-        maxDist = dist;
-        point1 = *p1;
-        point2 = *p2;
-      }
+  // A sphere around the centre of the box is sometimes tighter.
+  if (!m_bvh.empty()) {
+    const Point3D boxCenter = m_bvh.getBounds().center();
+    const double boxRadius = (farthestVertex(m_verts, boxCenter) - boxCenter).length();
+    if (boxRadius < radius) {
+      center = boxCenter;
+      radius = boxRadius;
     }
   }
 
-  double radius = maxDist / 2.0;
-  Point3D center = (1.0/2.0) * (point1 + point2);
-  m_boundingSphere = NonhierSphere(center, radius);
+  // Leave room for rounding so no vertex ends up just outside.
+  m_boundingSphere = NonhierSphere(center, radius * (1.0 + 1e-9));
 }
 
-bool Mesh::intersect(const Point3D& eye, const Vector3D& ray,  std::list<IntersectionPoint>& tVals) const
+Mesh::FaceFrame::FaceFrame(const std::vector<Point3D>& verts, const Face& face)
 {
-  // Draw bouding sphere instead?
-  // return m_boundingSphere.intersect(eye, ray,  minT, normal);
+  // Same frame a Polygon built from the face would use.
+  const Vector3D v1 = verts[face[0]] - verts[face[1]];
+  const Vector3D v2 = verts[face[2]] - verts[face[1]];
+
+  m_origin = verts[face[0]];
+  m_normal = v2.cross(v1);
+  m_normal.normalize();
+  m_up = v1;
+  m_up.normalize();
+  m_right = m_up.cross(m_normal);
+  m_right.normalize();
+
+  double minX = DBL_MAX, maxX = -DBL_MAX;
+  double minY = DBL_MAX, maxY = -DBL_MAX;
+  for (Face::const_iterator it = face.begin(); it != face.end(); it++) {
+    const Vector3D v = verts[*it] - m_origin;
+    const double x = v.dot(m_up);
+    const double y = v.dot(m_right);
+    if (x < minX) minX = x;
+    if (x > maxX) maxX = x;
+    if (y < minY) minY = y;
+    if (y > maxY) maxY = y;
+  }
+
+  m_minX = minX;
+  m_minY = minY;
+  m_width = maxX - minX;
+  m_height = maxY - minY;
+}
+
+bool Mesh::filteredIntersect(const Point3D& eye, const Vector3D& ray,
+                             HitList& tVals) const
+{
+  // The triangle test already counts a hit on a shared edge once.
+  if (intersect(eye, ray, tVals)) {
+    tVals.sort();
+    return true;
+  }
+
+  return false;
+}
+
+// Whether the line along the ray crosses the sphere, which is the same
+// quadratic as NonhierSphere::intersect having real roots. It only culls
+// meshes, so it's counted as a bounds test rather than a sphere test.
+static bool crossesSphere(const NonhierSphere& sphere, const Point3D& eye, const Vector3D& ray)
+{
+  countStat(STAT_BOUNDS_TESTS);
+
+  const Point3D& pos = sphere.getPosition();
+  double A = 0;
+  double B = 0;
+  double C = 0;
+  for (int i = 0; i < 3; i++) {
+    A += ray[i] * ray[i];
+    B += 2 * (eye[i] - pos[i]) * ray[i];
+    C += (eye[i] - pos[i]) * (eye[i] - pos[i]);
+  }
+  C -= sphere.getRadius() * sphere.getRadius();
+
+  return A != 0.0 && B * B - 4 * A * C >= 0.0;
+}
+
+// crossesSphere for each ray of the packet set in lanes.
+static int crossesSphere(const NonhierSphere& sphere, const RayPacket& packet, const int lanes)
+{
+  countStat(STAT_BOUNDS_TESTS, __builtin_popcount(lanes));
+
+  const Point3D& eye = packet.m_eye;
+  const Point3D& pos = sphere.getPosition();
+  Lanes A = Lanes();
+  Lanes B = Lanes();
+  double C = 0;
+  for (int i = 0; i < 3; i++) {
+    A += packet.m_ray[i] * packet.m_ray[i];
+    B += 2.0 * (eye[i] - pos[i]) * packet.m_ray[i];
+    C += (eye[i] - pos[i]) * (eye[i] - pos[i]);
+  }
+  C -= sphere.getRadius() * sphere.getRadius();
+
+  const Lanes D = B * B - 4.0 * A * C;
+  int crossed = 0;
+  for (int i = 0; i < PACKET_SIZE; i++) {
+    if ((lanes & (1 << i)) && A[i] != 0.0 && D[i] >= 0.0) {
+      crossed |= 1 << i;
+    }
+  }
+
+  return crossed;
+}
+
+bool Mesh::intersect(const Point3D& eye, const Vector3D& ray,  HitList& tVals) const
+{
+  countStat(STAT_MESH_TESTS);
 
   // First intersect with our bounding sphere.
-  std::list<IntersectionPoint> dummyTVals;
-  if (!m_boundingSphere.intersect(eye, ray,  dummyTVals)) {
+  if (!crossesSphere(m_boundingSphere, eye, ray)) {
     return false;
   }
 
-  for (std::vector<Polygon>::const_iterator it = m_polygons.begin(); it != m_polygons.end(); it++) {
-    it->intersect(eye, ray,  tVals);
-  }
+  // Hits behind the eye are still needed to pair up entry and exit points.
+  TriangleCollector collector(m_verts, m_normals, m_triangles, ShearedRay(eye, ray), tVals);
+  m_bvh.traverse(eye, ray, -DBL_MAX, DBL_MAX, collector);
 
   return tVals.size() != 0;
 }
 
+void Mesh::intersectPacket(const RayPacket& packet, const int lanes, HitList hits[]) const
+{
+  countStat(STAT_MESH_TESTS, __builtin_popcount(lanes));
+
+  const ShearedPacket ray(packet, lanes);
+  if (!ray.m_valid) {
+    Primitive::intersectPacket(packet, lanes, hits);
+    return;
+  }
+
+  const int inside = crossesSphere(m_boundingSphere, packet, lanes);
+  if (!inside) {
+    return;
+  }
+
+  const Lanes tMin = Lanes() - DBL_MAX;
+  Lanes tMax = Lanes() + DBL_MAX;
+  TrianglePacketCollector collector(m_verts, m_normals, m_triangles, ray, inside, hits);
+  m_bvh.traverse(packet, tMin, tMax, collector);
+
+  for (int i = 0; i < PACKET_SIZE; i++) {
+    hits[i].sort();
+  }
+}
+
+bool Mesh::anyHit(const Point3D& eye, const Vector3D& ray,
+                  const double tMin, const double tMax) const
+{
+  countStat(STAT_MESH_TESTS);
+
+  AnyTriangle any(m_verts, m_triangles, ShearedRay(eye, ray), tMin);
+  m_bvh.traverse(eye, ray, tMin, tMax, any);
+
+  return any.m_found;
+}
+
 bool Mesh::intersect(const Point3D& eye, const Vector3D& ray,  Point3D& poi) const
 {
-  std::list<IntersectionPoint> tVals;
-  if (intersect(eye, ray,  tVals)) {
-    double minT = DBL_MAX;
-    for (std::list<IntersectionPoint>::iterator it = tVals.begin(); it != tVals.end(); it++) {
-      if (it->m_t < minT) {
-        minT = it->m_t;
-      }
-    }
-    poi = eye + minT * ray;
-  
+  countStat(STAT_MESH_TESTS);
+
+  ClosestTriangle closest(m_verts, m_triangles, ShearedRay(eye, ray));
+  m_bvh.traverse(eye, ray, 0.0, DBL_MAX, closest);
+
+  if (closest.m_minT != DBL_MAX) {
+    poi = eye + closest.m_minT * ray;
     return true;
   }
   return false; 
@@ -96,9 +483,9 @@ bool Mesh::intersect(const Point3D& eye, const Vector3D& ray,  Point3D& poi) con
 
 bool Mesh::containsPoint(const Point3D& p) const
 {
-  // Each polygon normal and point define a constraint of the polyhedra
-  for (std::vector<Polygon>::const_iterator it = m_polygons.begin(); it != m_polygons.end(); it++) {
-    if (!it->checkConstraint(p)) {
+  // Each face normal and point define a constraint of the polyhedra
+  for (std::vector<FaceFrame>::const_iterator it = m_faces.begin(); it != m_faces.end(); it++) {
+    if (it->m_normal.dot(p - it->m_origin) >= tightEpsilon) {
       return false;
     }
   }
@@ -108,68 +495,95 @@ bool Mesh::containsPoint(const Point3D& p) const
 
 Vector3D Mesh::getNormal(const Point3D& p) const
 {
-  return determinePolygon(p).getNormal(p);
+  const Triangle& triangle = determineTriangle(p);
+
+  double bary[3];
+  triangle.barycentrics(m_verts, p, bary);
+  return triangle.getNormal(m_normals, bary);
 }
 
 Point2D Mesh::textureMapCoords(const Point3D& p) const
 {
-  return determinePolygon(p).textureMapCoords(p);
+  const Triangle& triangle = determineTriangle(p);
+
+  if (triangle.m_uv[0] >= 0) {
+    double bary[3];
+    triangle.barycentrics(m_verts, p, bary);
+
+    // Texture coordinates wrap, and images are stored top row first.
+    double u = 0.0, v = 0.0;
+    for (int i = 0; i < 3; i++) {
+      u += bary[i] * m_uvs[triangle.m_uv[i]][0];
+      v += bary[i] * m_uvs[triangle.m_uv[i]][1];
+    }
+    v = 1.0 - v;
+    return Point2D(u - floor(u), v - floor(v));
+  }
+
+  const FaceFrame& frame = m_faces[triangle.m_face];
+  const Vector3D v = p - frame.m_origin;
+
+  return Point2D((v.dot(frame.m_up) - frame.m_minX) / frame.m_width,
+                 (v.dot(frame.m_right) - frame.m_minY) / frame.m_height);
 }
 
-const Polygon& Mesh::determinePolygon(const Point3D& p) const
+const Triangle& Mesh::determineTriangle(const Point3D& p) const
 {
-  for (std::vector<Polygon>::const_iterator it = m_polygons.begin(); it != m_polygons.end(); it++) {
-    if (it->intersect(p)) {
-      return *it;
-    }
+  TriangleFinder finder(m_verts, m_triangles, p);
+  m_bvh.traverse(p, finder);
+
+  if (finder.m_found >= 0) {
+    return m_triangles[finder.m_found];
   }
 
-  std::cerr << "No Polygon found for point: " << p << std::endl;
-  return m_polygons.front();
+  std::cerr << "No Triangle found for point: " << p << std::endl;
+  return m_triangles.front();
 }
 
-Mesh* Mesh::getBoundingBox() const
+BoundingBox Mesh::getBounds() const
 {
-  // Dummy Implementation
-  std::cerr << "getBoudingBox() called on object it shouldn't have been called on" << std::endl;
-  return NULL;
+  // Every instance of the mesh reuses the bounds of its triangle hierarchy.
+  return m_bvh.getBounds();
 }
 
-void Mesh::transform(const Matrix4x4& m)
+void Mesh::write(CacheWriter& cache) const
 {
-  for (std::vector<Polygon>::iterator it = m_polygons.begin(); it != m_polygons.end(); it++) {
-    it->transform(m);
-  }
-  for (std::vector<Point3D>::iterator it = m_verts.begin(); it != m_verts.end(); it++) {
-     *it = m * *it;
+  cache.write(m_verts);
+  cache.write(m_normals);
+  cache.write(m_uvs);
+  cache.write(m_triangles);
+  cache.write(m_faces);
+  m_bvh.write(cache);
+  cache.write(m_boundingSphere.getPosition());
+  cache.write(m_boundingSphere.getRadius());
+}
+
+bool Mesh::read(CacheReader& cache)
+{
+  Point3D center;
+  double radius;
+  if (!cache.read(m_verts) || !cache.read(m_normals) || !cache.read(m_uvs) ||
+      !cache.read(m_triangles) || !cache.read(m_faces) || !m_bvh.read(cache) ||
+      !cache.read(center) || !cache.read(radius) || !cache.done()) {
+    return false;
   }
+
+  m_boundingSphere = NonhierSphere(center, radius);
+  return true;
 }
 
-void Mesh::getExtremePoints(double points[6]) const
+void Mesh::buildBVH()
 {
-  double minX, minY, minZ;
-  double maxX, maxY, maxZ;
-  minX = minY = minZ = DBL_MAX;
-  maxX = maxY = maxZ = -DBL_MAX;
+  std::vector<BoundingBox> bounds;
+  for (std::vector<Triangle>::const_iterator it = m_triangles.begin(); it != m_triangles.end(); it++) {
+    BoundingBox box = it->getBounds(m_verts);
 
-  for (std::vector<Point3D>::const_iterator it = m_verts.begin(); it != m_verts.end(); it++) {
-    Point3D p = *it;
-    if (p[0] < minX) {
-      minX = p[0];
-    }
-    if (p[0] > maxX) maxX = p[0];
-    if (p[1] < minY) minY = p[1];
-    if (p[1] > maxY) maxY = p[1];
-    if (p[2] < minZ) minZ = p[2];
-    if (p[2] > maxZ) maxZ = p[2];
-  }
-
-  points[0] = minX;
-  points[1] = maxX;
-  points[2] = minY;
-  points[3] = maxY;
-  points[4] = minZ;
-  points[5] = maxZ;
+    // Triangles are flat so pad them by the tolerance used to check points on them.
+    box.pad(epsilon);
+    bounds.push_back(box);
+  }
+
+  m_bvh.build(bounds);
 }
 
 std::ostream& operator<<(std::ostream& out, const Mesh& mesh)
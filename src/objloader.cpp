@@ -0,0 +1,484 @@
+#include "objloader.hpp"
+#include "primitive.hpp"
+#include "cache.hpp"
+#include <iostream>
+#include <sstream>
+#include <cstring>
+#include <cerrno>
+#include <cmath>
+#include <algorithm>
+#include <pthread.h>
+#include <unistd.h>
+
+// Smallest piece of a file worth giving its own thread.
+static const long MIN_CHUNK_SIZE = 1 << 20;
+
+enum LineType {
+  LINE_OTHER,
+  LINE_VERTEX,
+  LINE_NORMAL,
+  LINE_UV,
+  LINE_FACE
+};
+
+struct ObjData {
+  std::vector<Point3D> m_verts;
+  std::vector<Vector3D> m_normals;
+  std::vector<Point2D> m_uvs;
+  std::vector<Mesh::Face> m_faces;
+  std::vector<Mesh::Face> m_normalFaces;
+  std::vector<Mesh::Face> m_uvFaces;
+};
+
+/*
+  A run of whole lines of the file, handled by one thread.
+  The first pass counts what's in each chunk. That tells the second pass
+  where in ObjData the chunk's elements go and what its negative indices
+  refer to, so chunks can be parsed independently.
+*/
+struct ObjChunk {
+  ObjChunk(const char* begin, const char* end, ObjData* data)
+    : m_begin(begin), m_end(end), m_data(data),
+      m_lines(0), m_verts(0), m_normals(0), m_uvs(0), m_faces(0),
+      m_firstLine(0), m_vertBase(0), m_normalBase(0), m_uvBase(0), m_faceBase(0),
+      m_error()
+  {}
+
+  const char* m_begin;
+  const char* m_end;
+  ObjData* m_data;
+
+  // What's in the chunk.
+  int m_lines, m_verts, m_normals, m_uvs, m_faces;
+
+  // How many of each come before the chunk.
+  int m_firstLine, m_vertBase, m_normalBase, m_uvBase, m_faceBase;
+
+  // Set if the chunk couldn't be parsed.
+  std::string m_error;
+};
+
+static bool isBlank(const char c)
+{
+  return c == ' ' || c == '\t' || c == '\r';
+}
+
+static const char* skipBlanks(const char* p, const char* end)
+{
+  while (p < end && isBlank(*p)) {
+    p++;
+  }
+  return p;
+}
+
+static const char* lineEnd(const char* p, const char* end)
+{
+  const char* eol = (const char*)memchr(p, '\n', end - p);
+  return eol ? eol : end;
+}
+
+// Works out what a line holds and moves p past its keyword.
+static LineType classify(const char*& p, const char* end)
+{
+  p = skipBlanks(p, end);
+  if (end - p < 2) {
+    return LINE_OTHER;
+  }
+
+  if (p[0] == 'f' && isBlank(p[1])) {
+    p += 2;
+    return LINE_FACE;
+  }
+  if (p[0] != 'v') {
+    return LINE_OTHER;
+  }
+  if (isBlank(p[1])) {
+    p += 2;
+    return LINE_VERTEX;
+  }
+  if (end - p < 3 || !isBlank(p[2])) {
+    return LINE_OTHER;
+  }
+  if (p[1] == 'n') {
+    p += 3;
+    return LINE_NORMAL;
+  }
+  if (p[1] == 't') {
+    p += 3;
+    return LINE_UV;
+  }
+
+  return LINE_OTHER;
+}
+
+static bool isDigit(const char c)
+{
+  return c >= '0' && c <= '9';
+}
+
+// Decimal number with an optional exponent. Much faster than strtod, and
+// exact enough for geometry.
+static bool parseDouble(const char*& p, const char* end, double& value)
+{
+  static const double powers[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10,
+                                   1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19,
+                                   1e20, 1e21, 1e22 };
+
+  bool negative = false;
+  if (p < end && (*p == '-' || *p == '+')) {
+    negative = *p == '-';
+    p++;
+  }
+
+  const char* digits = p;
+  double mantissa = 0.0;
+  int exponent = 0;
+  for ( ; p < end && isDigit(*p); p++) {
+    mantissa = 10.0 * mantissa + (*p - '0');
+  }
+  if (p < end && *p == '.') {
+    p++;
+    for ( ; p < end && isDigit(*p); p++) {
+      mantissa = 10.0 * mantissa + (*p - '0');
+      exponent--;
+    }
+  }
+  if (p == digits || (p == digits + 1 && *digits == '.')) {
+    return false;
+  }
+
+  if (p < end && (*p == 'e' || *p == 'E')) {
+    p++;
+    int sign = 1;
+    if (p < end && (*p == '-' || *p == '+')) {
+      sign = *p == '-' ? -1 : 1;
+      p++;
+    }
+    if (p == end || !isDigit(*p)) {
+      return false;
+    }
+    int e = 0;
+    for ( ; p < end && isDigit(*p); p++) {
+      e = 10 * e + (*p - '0');
+    }
+    exponent += sign * e;
+  }
+
+  // Dividing by an exact power of ten rounds better than multiplying by its inverse.
+  if (exponent < 0) {
+    value = exponent >= -22 ? mantissa / powers[-exponent] : mantissa * pow(10.0, exponent);
+  } else {
+    value = exponent <= 22 ? mantissa * powers[exponent] : mantissa * pow(10.0, exponent);
+  }
+  if (negative) {
+    value = -value;
+  }
+
+  return true;
+}
+
+// Reads at least min and at most max numbers, leaving the rest at 0.
+// Anything after them (like a vertex's w) is ignored.
+static bool parseReals(const char* p, const char* end, Real* values, const int min, const int max)
+{
+  for (int i = 0; i < max; i++) {
+    p = skipBlanks(p, end);
+    if (p == end) {
+      return i >= min;
+    }
+    double value;
+    if (!parseDouble(p, end, value)) {
+      return false;
+    }
+    values[i] = value;
+  }
+
+  return true;
+}
+
+// OBJ indices start at 1, negative ones count back from the last element
+// read so far.
+static bool parseIndex(const char*& p, const char* end, const int before, const int total, int& index)
+{
+  bool negative = false;
+  if (p < end && *p == '-') {
+    negative = true;
+    p++;
+  }
+  if (p == end || !isDigit(*p)) {
+    return false;
+  }
+
+  int value = 0;
+  for ( ; p < end && isDigit(*p); p++) {
+    value = 10 * value + (*p - '0');
+  }
+
+  index = negative ? before - value : value - 1;
+  return value != 0 && index >= 0 && index < total;
+}
+
+static bool parseFace(const char* p, const char* end, const ObjChunk& chunk,
+                      const int vert, const int normal, const int uv,
+                      Mesh::Face& face, Mesh::Face& normalFace, Mesh::Face& uvFace)
+{
+  const ObjData& data = *chunk.m_data;
+
+  face.clear();
+  normalFace.clear();
+  uvFace.clear();
+
+  bool hasNormals = true;
+  bool hasUVs = true;
+  for (p = skipBlanks(p, end); p < end; p = skipBlanks(p, end)) {
+    int index;
+    if (!parseIndex(p, end, vert, data.m_verts.size(), index)) {
+      return false;
+    }
+    face.push_back(index);
+
+    // v, v/vt, v//vn or v/vt/vn
+    bool cornerUV = false, cornerNormal = false;
+    if (p < end && *p == '/') {
+      p++;
+      if (p < end && *p != '/') {
+        if (!parseIndex(p, end, uv, data.m_uvs.size(), index)) {
+          return false;
+        }
+        uvFace.push_back(index);
+        cornerUV = true;
+      }
+      if (p < end && *p == '/') {
+        p++;
+        if (!parseIndex(p, end, normal, data.m_normals.size(), index)) {
+          return false;
+        }
+        normalFace.push_back(index);
+        cornerNormal = true;
+      }
+    }
+    hasUVs = hasUVs && cornerUV;
+    hasNormals = hasNormals && cornerNormal;
+
+    if (p < end && !isBlank(*p)) {
+      return false;
+    }
+  }
+
+  // Only use normals and texture coordinates given for every corner.
+  if (!hasNormals) {
+    normalFace.clear();
+  }
+  if (!hasUVs) {
+    uvFace.clear();
+  }
+
+  return face.size() >= 3;
+}
+
+static void* countChunk(void* arg)
+{
+  ObjChunk* chunk = (ObjChunk*)arg;
+
+  for (const char* p = chunk->m_begin; p < chunk->m_end; ) {
+    const char* eol = lineEnd(p, chunk->m_end);
+    switch (classify(p, eol)) {
+      case LINE_VERTEX: chunk->m_verts++; break;
+      case LINE_NORMAL: chunk->m_normals++; break;
+      case LINE_UV: chunk->m_uvs++; break;
+      case LINE_FACE: chunk->m_faces++; break;
+      case LINE_OTHER: break;
+    }
+    chunk->m_lines++;
+    p = eol + 1;
+  }
+
+  return NULL;
+}
+
+static void* parseChunk(void* arg)
+{
+  ObjChunk* chunk = (ObjChunk*)arg;
+  ObjData& data = *chunk->m_data;
+
+  int line = chunk->m_firstLine;
+  int vert = chunk->m_vertBase;
+  int normal = chunk->m_normalBase;
+  int uv = chunk->m_uvBase;
+  int face = chunk->m_faceBase;
+
+  // Corners are collected here first so each face allocates once.
+  Mesh::Face corners, normalCorners, uvCorners;
+
+  for (const char* p = chunk->m_begin; p < chunk->m_end; ) {
+    const char* eol = lineEnd(p, chunk->m_end);
+    line++;
+
+    bool ok = true;
+    switch (classify(p, eol)) {
+      case LINE_VERTEX:
+        ok = parseReals(p, eol, &data.m_verts[vert++][0], 3, 3);
+        break;
+      case LINE_NORMAL:
+        ok = parseReals(p, eol, &data.m_normals[normal++][0], 3, 3);
+        break;
+      case LINE_UV:
+        ok = parseReals(p, eol, &data.m_uvs[uv++][0], 1, 2);
+        break;
+      case LINE_FACE:
+        ok = parseFace(p, eol, *chunk, vert, normal, uv, corners, normalCorners, uvCorners);
+        if (ok) {
+          data.m_faces[face] = corners;
+          data.m_normalFaces[face] = normalCorners;
+          data.m_uvFaces[face] = uvCorners;
+          face++;
+        }
+        break;
+      case LINE_OTHER:
+        break;
+    }
+
+    if (!ok) {
+      std::ostringstream error;
+      error << "bad data on line " << line;
+      chunk->m_error = error.str();
+      return NULL;
+    }
+
+    p = eol + 1;
+  }
+
+  return NULL;
+}
+
+static void runChunks(std::vector<ObjChunk>& chunks, void* (*work)(void*))
+{
+  if (chunks.size() == 1) {
+    work(&chunks.front());
+    return;
+  }
+
+  std::vector<pthread_t> threads(chunks.size());
+  for (unsigned int i = 0; i < chunks.size(); i++) {
+    pthread_create(&threads[i], NULL, work, &chunks[i]);
+  }
+  for (unsigned int i = 0; i < chunks.size(); i++) {
+    pthread_join(threads[i], NULL);
+  }
+}
+
+// Splits the file into one chunk per core, each ending at a line break.
+static void splitChunks(const char* begin, const char* end, ObjData* data,
+                        std::vector<ObjChunk>& chunks)
+{
+  const long size = end - begin;
+  long numChunks = std::min(sysconf(_SC_NPROCESSORS_ONLN), size / MIN_CHUNK_SIZE + 1);
+  if (numChunks < 1) {
+    numChunks = 1;
+  }
+
+  const char* p = begin;
+  for (long i = 1; i <= numChunks && p < end; i++) {
+    const char* chunkEnd = end;
+    if (i < numChunks) {
+      const char* target = std::max(p, begin + size * i / numChunks);
+      chunkEnd = lineEnd(target, end);
+      if (chunkEnd < end) {
+        chunkEnd++;
+      }
+    }
+
+    chunks.push_back(ObjChunk(p, chunkEnd, data));
+    p = chunkEnd;
+  }
+}
+
+static bool readObjData(const std::string& filename, const MappedFile& file, ObjData& data)
+{
+  if (file.size() == 0) {
+    std::cerr << "Error reading " << filename << ": file is empty" << std::endl;
+    return false;
+  }
+
+  std::vector<ObjChunk> chunks;
+  splitChunks(file.data(), file.data() + file.size(), &data, chunks);
+
+  runChunks(chunks, countChunk);
+
+  // Give every chunk its place in the output.
+  ObjChunk total(NULL, NULL, &data);
+  for (std::vector<ObjChunk>::iterator it = chunks.begin(); it != chunks.end(); it++) {
+    it->m_firstLine = total.m_lines;
+    it->m_vertBase = total.m_verts;
+    it->m_normalBase = total.m_normals;
+    it->m_uvBase = total.m_uvs;
+    it->m_faceBase = total.m_faces;
+
+    total.m_lines += it->m_lines;
+    total.m_verts += it->m_verts;
+    total.m_normals += it->m_normals;
+    total.m_uvs += it->m_uvs;
+    total.m_faces += it->m_faces;
+  }
+
+  data.m_verts.resize(total.m_verts);
+  data.m_normals.resize(total.m_normals);
+  data.m_uvs.resize(total.m_uvs);
+  data.m_faces.resize(total.m_faces);
+  data.m_normalFaces.resize(total.m_faces);
+  data.m_uvFaces.resize(total.m_faces);
+
+  runChunks(chunks, parseChunk);
+
+  for (std::vector<ObjChunk>::iterator it = chunks.begin(); it != chunks.end(); it++) {
+    if (!it->m_error.empty()) {
+      std::cerr << "Error reading " << filename << ": " << it->m_error << std::endl;
+      return false;
+    }
+  }
+
+  if (data.m_faces.empty()) {
+    std::cerr << "Error reading " << filename << ": no faces found" << std::endl;
+    return false;
+  }
+
+  return true;
+}
+
+Mesh* readObj(const std::string& filename)
+{
+  MappedFile file;
+  if (!file.open(filename)) {
+    std::cerr << "Error opening " << filename << ": " << strerror(errno) << std::endl;
+    return NULL;
+  }
+
+  // The cache is only used if it was built from exactly this file.
+  const std::string cacheName = filename + ".cache";
+  const uint64_t key = hashBytes(file.data(), file.size());
+
+  CacheReader cache(cacheName, key);
+  if (cache.ok()) {
+    Mesh* mesh = new Mesh();
+    if (mesh->read(cache)) {
+      return mesh;
+    }
+    delete mesh;
+  }
+
+  ObjData data;
+  if (!readObjData(filename, file, data)) {
+    return NULL;
+  }
+
+  Mesh* mesh = new Mesh(data.m_verts, data.m_faces, data.m_normals, data.m_normalFaces,
+                        data.m_uvs, data.m_uvFaces);
+
+  CacheWriter writer(cacheName, key);
+  mesh->write(writer);
+  if (!writer.close()) {
+    std::cerr << "Warning: could not write " << cacheName << std::endl;
+  }
+
+  return mesh;
+}
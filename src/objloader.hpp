@@ -0,0 +1,19 @@
+#ifndef OBJLOADER_HPP
+#define OBJLOADER_HPP
+
+#include <string>
+
+class Mesh;
+
+/*
+  Reads a Wavefront OBJ file straight into a Mesh.
+  Handles v, vn, vt and f lines, including v/vt/vn corners and negative
+  (relative) indices. Everything else in the file is ignored.
+  The file is memory mapped and large files are parsed in parallel chunks.
+  The built mesh is cached in filename.cache, which later runs load instead
+  of parsing as long as the OBJ file hasn't changed.
+  Returns NULL, after saying why, if the file can't be read.
+*/
+Mesh* readObj(const std::string& filename);
+
+#endif
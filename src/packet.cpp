@@ -0,0 +1,31 @@
+#include "packet.hpp"
+
+RayPacket::RayPacket(const Point3D& eye, const Vector3D rays[], const int count)
+  : m_eye(eye),
+    m_count(count),
+    m_active((1 << count) - 1)
+{
+  for (int lane = 0; lane < PACKET_SIZE; lane++) {
+    const Vector3D& ray = rays[std::min(lane, count - 1)];
+    for (int i = 0; i < 3; i++) {
+      m_ray[i][lane] = ray[i];
+    }
+  }
+
+  for (int i = 0; i < 3; i++) {
+    m_invRay[i] = 1.0 / m_ray[i];
+  }
+}
+
+RayPacket::RayPacket(const Matrix4x4& trans, const RayPacket& packet)
+  : m_eye(trans * packet.m_eye),
+    m_count(packet.m_count),
+    m_active(packet.m_active)
+{
+  // Same sums, in the same order, as transforming each ray on its own.
+  for (int i = 0; i < 3; i++) {
+    m_ray[i] = packet.m_ray[0] * trans[i][0] + packet.m_ray[1] * trans[i][1] +
+               packet.m_ray[2] * trans[i][2];
+    m_invRay[i] = 1.0 / m_ray[i];
+  }
+}
@@ -0,0 +1,56 @@
+#ifndef PACKET_HPP
+#define PACKET_HPP
+
+#include "algebra.hpp"
+
+/*
+  A few rays from the same eye, traced together.
+  Each coordinate of the rays is kept in a vector of lanes, one lane per
+  ray, so arithmetic on the whole packet compiles to SIMD instructions
+  (one AVX or two SSE2 instructions for four doubles).
+
+  Lanes are passed by reference: passing them by value changes the ABI
+  depending on whether AVX is enabled.
+*/
+
+static const int PACKET_SIZE = 4;
+
+typedef double Lanes __attribute__((vector_size(PACKET_SIZE * sizeof(double))));
+// Result of comparing Lanes: all bits set in the lanes where it holds.
+typedef long long LaneMask __attribute__((vector_size(PACKET_SIZE * sizeof(long long))));
+
+// Bit i is set if lane i of mask is.
+inline int laneBits(const LaneMask& mask)
+{
+  int bits = 0;
+  for (int i = 0; i < PACKET_SIZE; i++) {
+    if (mask[i]) {
+      bits |= 1 << i;
+    }
+  }
+  return bits;
+}
+
+struct RayPacket {
+  // Unused lanes repeat the last ray, so they can be traced harmlessly.
+  RayPacket(const Point3D& eye, const Vector3D rays[], const int count);
+
+  // The packet after a change of coordinates.
+  RayPacket(const Matrix4x4& trans, const RayPacket& packet);
+
+  Vector3D ray(const int lane) const
+  {
+    return Vector3D(m_ray[0][lane], m_ray[1][lane], m_ray[2][lane]);
+  }
+
+  Point3D m_eye;
+  Lanes m_ray[3];
+  // Reciprocals of m_ray, for slab tests.
+  Lanes m_invRay[3];
+
+  int m_count;
+  // Bit i is set for each lane in use.
+  int m_active;
+};
+
+#endif
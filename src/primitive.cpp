@@ -1,5 +1,6 @@
 #include "primitive.hpp"
 #include "polyroots.hpp"
+#include "stats.hpp"
 #include <cfloat>
 
 Primitive::~Primitive()
@@ -7,53 +8,80 @@ Primitive::~Primitive()
 }
 
 bool Primitive::filteredIntersect(const Point3D& eye, const Vector3D& ray, 
-                                  std::list<IntersectionPoint>& tValues) const
+                                  HitList& tValues) const
 {
   if (intersect(eye, ray,  tValues)) { 
-    tValues.sort();
-
-    //int numVals = tValues.size();
-
-    // Here we have to eliminate dupicates that occur due to points passing
-    // through an edge or a corner. We must be careful not to eliminate duplicates
-    // that occur from an intersection on a corner or edge.
-    // We will differentiate by checking two points up and down the ray near the point.
-    std::list<std::list<IntersectionPoint>::iterator> pointsToRemove;
-    std::list<IntersectionPoint>::iterator prev = tValues.begin();
-    std::list<IntersectionPoint>::iterator curr = tValues.begin();
-    curr++;
-    for (; prev != tValues.end(); curr++, prev++) {
-      if (equal(curr->m_t, prev->m_t, tightEpsilon)) {
-        if (containsPoint(eye + (curr->m_t + 100 * tightEpsilon) * ray) ||
-            containsPoint(eye + (curr->m_t - 100 * tightEpsilon) * ray)) {
-          // Now if there's more than 2 we should remove them as well
-          for ( ; equal(curr->m_t, prev->m_t, tightEpsilon) && curr != tValues.end(); curr++, prev++) {
-            pointsToRemove.push_back(curr);
-          }
+    filterHits(eye, ray, tValues);
+    return true;
+  }
+
+  return false;
+}
+
+void Primitive::filterHits(const Point3D& eye, const Vector3D& ray, HitList& tValues) const
+{
+  tValues.sort();
+
+  //int numVals = tValues.size();
+
+  // Here we have to eliminate dupicates that occur due to points passing
+  // through an edge or a corner. We must be careful not to eliminate duplicates
+  // that occur from an intersection on a corner or edge.
+  // We will differentiate by checking two points up and down the ray near the point.
+  // Compacts the kept points to the front in place.
+  int numKept = 0;
+  int i = 0;
+  while (i < tValues.size()) {
+    tValues[numKept++] = tValues[i];
+    double t = tValues[i].m_t;
+    i++;
+    if (i < tValues.size() && equal(tValues[i].m_t, t, tightEpsilon)) {
+      if (containsPoint(eye + (t + 100 * tightEpsilon) * ray) ||
+          containsPoint(eye + (t - 100 * tightEpsilon) * ray)) {
+        // Now if there's more than 2 we should remove them as well
+        for ( ; i < tValues.size() && equal(tValues[i].m_t, tValues[i - 1].m_t, tightEpsilon); i++) {
         }
       }
     }
-    // Now remove
-    for (std::list<std::list<IntersectionPoint>::iterator>::iterator it = pointsToRemove.begin();
-          it != pointsToRemove.end(); it++) {
-      tValues.erase(*it);
-    } 
+  }
+  countStat(STAT_DUPLICATE_HITS, tValues.size() - numKept);
+  tValues.resize(numKept);
 
 /* This still happens sometimes, not a big deal though so ignore it
-    // Now we should have an even number of points.
-    if (tValues.size() % 2 != 0) {
+  // Now we should have an even number of points.
+  if (tValues.size() % 2 != 0) {
 
-      std::cerr << std::endl << "Error! Number of intersection points is odd: " << numVals << " "
-                << " " << tValues.size() << " ";
-      for (std::list<IntersectionPoint>::iterator it = tValues.begin(); it != tValues.end(); it++)
-        std::cerr << it->m_t << " " << eye + it->m_t * ray << " ";
-      std::cerr << std::endl;
+    std::cerr << std::endl << "Error! Number of intersection points is odd: " << numVals << " "
+              << " " << tValues.size() << " ";
+    for (HitList::iterator it = tValues.begin(); it != tValues.end(); it++)
+      std::cerr << it->m_t << " " << eye + it->m_t * ray << " ";
+    std::cerr << std::endl;
 
-      return false;
-    }
+    return false;
+  }
 
 */
-    return true;
+}
+
+void Primitive::intersectPacket(const RayPacket& packet, const int lanes, HitList hits[]) const
+{
+  for (int i = 0; i < PACKET_SIZE; i++) {
+    if (lanes & (1 << i)) {
+      filteredIntersect(packet.m_eye, packet.ray(i), hits[i]);
+    }
+  }
+}
+
+bool Primitive::anyHit(const Point3D& eye, const Vector3D& ray,
+                       const double tMin, const double tMax) const
+{
+  HitList tVals;
+  if (filteredIntersect(eye, ray, tVals)) {
+    for (HitList::const_iterator it = tVals.begin(); it != tVals.end(); it++) {
+      if (it->m_t > tMin && it->m_t < tMax) {
+        return true;
+      }
+    }
   }
 
   return false;
@@ -61,7 +89,7 @@ bool Primitive::filteredIntersect(const Point3D& eye, const Vector3D& ray,
 
 bool Primitive::checkQuadraticRoots(const Point3D& eye, const Vector3D& ray,
                                     const double A, const double B, const double C,
-                                    std::list<IntersectionPoint>& tVals) const
+                                    HitList& tVals) const
 {
   bool pointFound = false;
   
@@ -96,8 +124,10 @@ NonhierSphere::~NonhierSphere()
 }
 
 bool NonhierSphere::intersect(const Point3D& eye, const Vector3D& ray, 
-                              std::list<IntersectionPoint>& tVals) const 
+                              HitList& tVals) const 
 {
+  countStat(STAT_SPHERE_TESTS);
+
   double A = 0; 
   double B = 0;
   double C = 0;
@@ -117,6 +147,81 @@ bool NonhierSphere::intersect(const Point3D& eye, const Vector3D& ray,
   return tVals.size() != 0;
 }
 
+void NonhierSphere::intersectPacket(const RayPacket& packet, const int lanes,
+                                    HitList hits[]) const
+{
+  countStat(STAT_SPHERE_TESTS, __builtin_popcount(lanes));
+
+  // The same quadratic as intersect, for every ray at once.
+  const Point3D& eye = packet.m_eye;
+  Lanes A = Lanes();
+  Lanes B = Lanes();
+  double C = 0;
+  for (int i = 0; i < 3; i++) {
+    A += packet.m_ray[i] * packet.m_ray[i];
+    B += 2.0 * (eye[i] - m_pos[i]) * packet.m_ray[i];
+    C += (eye[i] - m_pos[i]) * (eye[i] - m_pos[i]);
+  }
+  C -= m_radius * m_radius;
+
+  // Roots as quadraticRoots finds them.
+  const Lanes D = B * B - 4.0 * A * C;
+  Lanes sqrtD = Lanes();
+  for (int i = 0; i < PACKET_SIZE; i++) {
+    sqrtD[i] = D[i] < 0.0 ? 0.0 : sqrt(D[i]);
+  }
+  const Lanes one = Lanes() + 1.0;
+  const Lanes q = -(B + (B < 0.0 ? -one : one) * sqrtD) / 2.0;
+  const Lanes root0 = q / A;
+  const Lanes root1 = q != 0.0 ? C / q : root0;
+
+  for (int i = 0; i < PACKET_SIZE; i++) {
+    if (!(lanes & (1 << i))) {
+      continue;
+    }
+
+    const Vector3D ray = packet.ray(i);
+    if (A[i] == 0.0) {
+      // A zero length ray, leave it to the general code.
+      filteredIntersect(eye, ray, hits[i]);
+    } else if (D[i] >= 0.0) {
+      const double roots[2] = { root0[i], root1[i] };
+      for (int j = 0; j < 2; j++) {
+        Point3D poi = eye + roots[j] * ray;
+        hits[i].push_back(IntersectionPoint(roots[j], getNormal(poi)));
+      }
+      filterHits(eye, ray, hits[i]);
+    }
+  }
+}
+
+bool NonhierSphere::anyHit(const Point3D& eye, const Vector3D& ray,
+                           const double tMin, const double tMax) const
+{
+  countStat(STAT_SPHERE_TESTS);
+
+  double A = 0; 
+  double B = 0;
+  double C = 0;
+
+  for (int i = 0; i < 3; i++) {
+   A += ray[i] * ray[i];
+   B += 2 * (eye[i] - m_pos[i]) * ray[i];
+   C += (eye[i] - m_pos[i]) * (eye[i] - m_pos[i]);
+  }
+  C -= m_radius * m_radius;
+
+  double roots[2];
+  int numRoots = quadraticRoots(A, B, C, roots); 
+  for (int i = 0; i < numRoots; i++) {
+    if (roots[i] > tMin && roots[i] < tMax) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
 bool NonhierSphere::containsPoint(const Point3D& p) const
 {
   return (p - m_pos).length() < m_radius;
@@ -154,31 +259,12 @@ Point2D NonhierSphere::textureMapCoords(const Point3D& p) const
   return Point2D(longitude, lat);  
 }
 
-Mesh* NonhierSphere::getBoundingBox() const
+BoundingBox NonhierSphere::getBounds() const
 {
-  Point3D pos(m_pos[0] - m_radius, m_pos[1] - m_radius, m_pos[2] - m_radius);
-  double size = 2 * m_radius;
-
-  std::vector<Point3D> vertices;
-  vertices.push_back(Point3D(pos[0], pos[1], pos[2]));
-  vertices.push_back(Point3D(pos[0] + size, pos[1], pos[2]));
-  vertices.push_back(Point3D(pos[0] + size, pos[1] + size, pos[2]));
-  vertices.push_back(Point3D(pos[0], pos[1] + size, pos[2]));
-  vertices.push_back(Point3D(pos[0], pos[1], pos[2] + size));
-  vertices.push_back(Point3D(pos[0] + size, pos[1], pos[2] + size));
-  vertices.push_back(Point3D(pos[0] + size, pos[1] + size, pos[2] + size));
-  vertices.push_back(Point3D(pos[0], pos[1] + size, pos[2] + size));
-
-  std::vector<std::vector<int> > f;
-  int faces[6][4] = { {3, 2, 1, 0}, // Front
-                      {0, 1, 5, 4}, // Bottom
-                      {2, 6, 5, 1}, // Right
-                      {7, 3, 0, 4}, // Left
-                      {7, 6, 2, 3}, // Top
-                      {4, 5, 6, 7}}; // Back
-  for (int i = 0; i < 6; i++) f.push_back(std::vector<int> (faces[i], faces[i] + 4));
+  Point3D min(m_pos[0] - m_radius, m_pos[1] - m_radius, m_pos[2] - m_radius);
+  Point3D max(m_pos[0] + m_radius, m_pos[1] + m_radius, m_pos[2] + m_radius);
 
-  return new Mesh(vertices, f);
+  return BoundingBox(min, max);
 }
 
 /*
@@ -189,37 +275,24 @@ Mesh* NonhierSphere::getBoundingBox() const
   ********** NonhierBox **********
 */
 
+// Texture orientation of each face, ordered -x, +x, -y, +y, -z, +z.
+// Coordinates run along up then right, matching the old polygonal box.
+static const Vector3D boxUp[6] = { Vector3D(0.0, -1.0, 0.0), Vector3D(0.0, 1.0, 0.0),
+                                   Vector3D(0.0, 0.0, -1.0), Vector3D(0.0, 0.0, 1.0),
+                                   Vector3D(0.0, 1.0, 0.0), Vector3D(0.0, -1.0, 0.0) };
+static const Vector3D boxRight[6] = { Vector3D(0.0, 0.0, -1.0), Vector3D(0.0, 0.0, -1.0),
+                                      Vector3D(-1.0, 0.0, 0.0), Vector3D(-1.0, 0.0, 0.0),
+                                      Vector3D(-1.0, 0.0, 0.0), Vector3D(-1.0, 0.0, 0.0) };
+
+// Position of local point l (in [0, 1]^3) along the axis direction d, in [0, 1].
+static double boxCoord(const Vector3D& d, const Vector3D& l)
+{
+  return d.dot(l) + (d[0] + d[1] + d[2] < 0.0 ? 1.0 : 0.0);
+}
+
 NonhierBox::NonhierBox(const Point3D& pos, double size)
-  : m_box(std::vector<Point3D>(), std::vector<std::vector<int> >())
-{
-  std::vector<Point3D> vertices;
-  vertices.push_back(Point3D(pos[0], pos[1], pos[2]));
-  vertices.push_back(Point3D(pos[0] + size, pos[1], pos[2]));
-  vertices.push_back(Point3D(pos[0] + size, pos[1] + size, pos[2]));
-  vertices.push_back(Point3D(pos[0], pos[1] + size, pos[2]));
-  vertices.push_back(Point3D(pos[0], pos[1], pos[2] + size));
-  vertices.push_back(Point3D(pos[0] + size, pos[1], pos[2] + size));
-  vertices.push_back(Point3D(pos[0] + size, pos[1] + size, pos[2] + size));
-  vertices.push_back(Point3D(pos[0], pos[1] + size, pos[2] + size));
-
-  std::vector<std::vector<int> > f;
-  int faces[6][4] = { {3, 2, 1, 0}, // Front
-                      {0, 1, 5, 4}, // Bottom
-                      {2, 6, 5, 1}, // Right
-                      {7, 3, 0, 4}, // Left
-                      {7, 6, 2, 3}, // Top
-                      {4, 5, 6, 7}}; // Back
-  for (int i = 0; i < 6; i++) f.push_back(std::vector<int> (faces[i], faces[i] + 4));
-
-  std::vector<Vector3D> upVectors;
-  upVectors.push_back(Vector3D(0.0, 1.0, 0.0));
-  upVectors.push_back(Vector3D(0.0, 0.0, -1.0));
-  upVectors.push_back(Vector3D(0.0, 1.0, 0.0));
-  upVectors.push_back(Vector3D(0.0, -1.0, 0.0));
-  upVectors.push_back(Vector3D(0.0, 0.0, 1.0));
-  upVectors.push_back(Vector3D(0.0, -1.0, 0.0));
-
-  m_box = Mesh(vertices, f, upVectors);
+  : m_box(pos, pos + Vector3D(size, size, size))
+{
 }
 
 NonhierBox::~NonhierBox()
@@ -227,31 +300,135 @@ NonhierBox::~NonhierBox()
 }
 
 bool NonhierBox::intersect(const Point3D& eye, const Vector3D& ray, 
-                           std::list<IntersectionPoint>& tVals) const
+                           HitList& tVals) const
+{
+  countStat(STAT_BOX_TESTS);
+
+  double tNear, tFar;
+  int nearAxis, farAxis;
+  if (!m_box.intersectLine(eye, ray, tNear, nearAxis, tFar, farAxis)) {
+    return false;
+  }
+
+  // The entry face points against the ray and the exit face along it.
+  Vector3D nearNormal, farNormal;
+  nearNormal[nearAxis] = ray[nearAxis] > 0.0 ? -1.0 : 1.0;
+  farNormal[farAxis] = ray[farAxis] > 0.0 ? 1.0 : -1.0;
+
+  tVals.push_back(IntersectionPoint(tNear, nearNormal));
+  tVals.push_back(IntersectionPoint(tFar, farNormal));
+
+  return true;
+}
+
+void NonhierBox::intersectPacket(const RayPacket& packet, const int lanes,
+                                 HitList hits[]) const
+{
+  countStat(STAT_BOX_TESTS, __builtin_popcount(lanes));
+
+  // intersectLine for every ray at once.
+  Lanes tNear = Lanes() - DBL_MAX;
+  Lanes tFar = Lanes() + DBL_MAX;
+  LaneMask nearAxis = LaneMask();
+  LaneMask farAxis = LaneMask();
+
+  for (int i = 0; i < 3; i++) {
+    const Lanes& inv = packet.m_invRay[i];
+    const Lanes t0 = (m_box.min()[i] - packet.m_eye[i]) * inv;
+    const Lanes t1 = (m_box.max()[i] - packet.m_eye[i]) * inv;
+
+    const LaneMask negative = inv < 0.0;
+    const Lanes tEnter = negative ? t1 : t0;
+    const Lanes tLeave = negative ? t0 : t1;
+
+    nearAxis = tEnter > tNear ? LaneMask() + i : nearAxis;
+    tNear = tEnter > tNear ? tEnter : tNear;
+    farAxis = tLeave < tFar ? LaneMask() + i : farAxis;
+    tFar = tLeave < tFar ? tLeave : tFar;
+  }
+
+  const int hit = laneBits(tNear <= tFar) & lanes;
+  for (int i = 0; i < PACKET_SIZE; i++) {
+    if (!(hit & (1 << i))) {
+      continue;
+    }
+
+    const Vector3D ray = packet.ray(i);
+    Vector3D nearNormal, farNormal;
+    nearNormal[nearAxis[i]] = ray[nearAxis[i]] > 0.0 ? -1.0 : 1.0;
+    farNormal[farAxis[i]] = ray[farAxis[i]] > 0.0 ? 1.0 : -1.0;
+
+    hits[i].push_back(IntersectionPoint(tNear[i], nearNormal));
+    hits[i].push_back(IntersectionPoint(tFar[i], farNormal));
+    filterHits(packet.m_eye, ray, hits[i]);
+  }
+}
+
+bool NonhierBox::anyHit(const Point3D& eye, const Vector3D& ray,
+                        const double tMin, const double tMax) const
 {
-  return m_box.intersect(eye, ray,  tVals);
+  countStat(STAT_BOX_TESTS);
+
+  double tNear, tFar;
+  int nearAxis, farAxis;
+  if (!m_box.intersectLine(eye, ray, tNear, nearAxis, tFar, farAxis)) {
+    return false;
+  }
+
+  return (tNear > tMin && tNear < tMax) || (tFar > tMin && tFar < tMax);
 }
 
 bool NonhierBox::containsPoint(const Point3D& p) const
 {
-  return m_box.containsPoint(p);
+  for (int i = 0; i < 3; i++) {
+    if (p[i] < m_box.min()[i] - tightEpsilon || p[i] > m_box.max()[i] + tightEpsilon) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+int NonhierBox::determineFace(const Point3D& p) const
+{
+  int face = 0;
+  double minDist = DBL_MAX;
+  for (int i = 0; i < 3; i++) {
+    const double toMin = fabs(p[i] - m_box.min()[i]);
+    const double toMax = fabs(p[i] - m_box.max()[i]);
+    if (toMin < minDist) {
+      minDist = toMin;
+      face = 2 * i;
+    }
+    if (toMax < minDist) {
+      minDist = toMax;
+      face = 2 * i + 1;
+    }
+  }
+
+  return face;
 }
 
 Vector3D NonhierBox::getNormal(const Point3D& p) const
 {
-  return m_box.getNormal(p);
+  const int face = determineFace(p);
+
+  Vector3D normal;
+  normal[face / 2] = (face % 2) ? 1.0 : -1.0;
+  return normal;
 }
 
 Point2D NonhierBox::textureMapCoords(const Point3D& p) const
 {
-  return m_box.textureMapCoords(p);
+  const int face = determineFace(p);
+  const Vector3D l = (1.0 / (m_box.max()[0] - m_box.min()[0])) * (p - m_box.min());
+
+  return Point2D(boxCoord(boxUp[face], l), boxCoord(boxRight[face], l));
 }
 
-Mesh* NonhierBox::getBoundingBox() const
+BoundingBox NonhierBox::getBounds() const
 {
-  // Dummy Implementation
-  std::cerr << "getBoudingBox() called on object it shouldn't have been called on" << std::endl;
-  return NULL;
+  return m_box;
 }
 
 /* 
@@ -263,11 +440,22 @@ Sphere::~Sphere()
 }
 
 bool Sphere::intersect(const Point3D& eye, const Vector3D& ray, 
-                       std::list<IntersectionPoint>& tVals) const
+                       HitList& tVals) const
 {
   return m_unitSphere.intersect(eye, ray,  tVals);
 }
 
+void Sphere::intersectPacket(const RayPacket& packet, const int lanes, HitList hits[]) const
+{
+  m_unitSphere.intersectPacket(packet, lanes, hits);
+}
+
+bool Sphere::anyHit(const Point3D& eye, const Vector3D& ray,
+                    const double tMin, const double tMax) const
+{
+  return m_unitSphere.anyHit(eye, ray, tMin, tMax);
+}
+
 bool Sphere::containsPoint(const Point3D& p) const
 {
   return m_unitSphere.containsPoint(p);
@@ -283,9 +471,9 @@ Point2D Sphere::textureMapCoords(const Point3D& p) const
   return m_unitSphere.textureMapCoords(p);
 }
 
-Mesh* Sphere::getBoundingBox() const
+BoundingBox Sphere::getBounds() const
 {
-  return m_unitSphere.getBoundingBox();
+  return m_unitSphere.getBounds();
 }
 
 /* 
@@ -297,11 +485,22 @@ Cube::~Cube()
 }
 
 bool Cube::intersect(const Point3D& eye, const Vector3D& ray, 
-                     std::list<IntersectionPoint>& tVals) const
+                     HitList& tVals) const
 {
   return m_unitCube.intersect(eye, ray,  tVals);
 }
 
+void Cube::intersectPacket(const RayPacket& packet, const int lanes, HitList hits[]) const
+{
+  m_unitCube.intersectPacket(packet, lanes, hits);
+}
+
+bool Cube::anyHit(const Point3D& eye, const Vector3D& ray,
+                  const double tMin, const double tMax) const
+{
+  return m_unitCube.anyHit(eye, ray, tMin, tMax);
+}
+
 bool Cube::containsPoint(const Point3D& p) const
 {
   return m_unitCube.containsPoint(p);
@@ -317,11 +516,9 @@ Point2D Cube::textureMapCoords(const Point3D& p) const
   return m_unitCube.textureMapCoords(p);
 }
 
-Mesh* Cube::getBoundingBox() const
+BoundingBox Cube::getBounds() const
 {
-  // Dummy Implementation
-  std::cerr << "getBoudingBox() called on object it shouldn't have been called on" << std::endl;
-  return NULL;
+  return m_unitCube.getBounds();
 }
 
 /* 
@@ -338,8 +535,10 @@ Cone::~Cone()
 }
 
 bool Cone::intersect(const Point3D& eye, const Vector3D& ray, 
-                     std::list<IntersectionPoint>& tVals) const
+                     HitList& tVals) const
 {
+  countStat(STAT_CONE_TESTS);
+
   double A = 0, B = 0, C = 0;
 
   for (int i = 0; i < 3; i++) {
@@ -403,11 +602,9 @@ int Cone::determineRegion(const Point3D& p) const
   }
 }
 
-Mesh* Cone::getBoundingBox() const
+BoundingBox Cone::getBounds() const
 {
-  // Dummy Implementation
-  std::cerr << "getBoudingBox() called on object it shouldn't have been called on" << std::endl;
-  return NULL;
+  return BoundingBox(Point3D(-1.0, -1.0, 0.0), Point3D(1.0, 1.0, 1.0));
 }
 
 /* 
@@ -425,8 +622,10 @@ Cylinder::~Cylinder()
 }
 
 bool Cylinder::intersect(const Point3D& eye, const Vector3D& ray, 
-                         std::list<IntersectionPoint>& tVals) const
+                         HitList& tVals) const
 {
+  countStat(STAT_CYLINDER_TESTS);
+
   double A = 0, B = 0, C = 0;
 
   for (int i = 0; i < 2; i++) {
@@ -471,7 +670,8 @@ Point2D Cylinder::textureMapCoords(const Point3D& p) const
   int region = determineRegion(p);
 
   if (region == 0) {
-    double theta = acos(p[0]);
+    // Rounding can put the point just off the unit circle.
+    double theta = acos(std::max(-1.0, std::min(1.0, (double)p[0])));
 
     if (p[1] < 0) {
       theta = -theta;
@@ -504,32 +704,9 @@ int Cylinder::determineRegion(const Point3D& p) const
   }
 }
 
-Mesh* Cylinder::getBoundingBox() const
-{
-  Point3D pos(-1.0, -1.0, 0.0);
-  double xySize = 2.0;
-  double zSize = 1.0;
-
-  std::vector<Point3D> vertices;
-  vertices.push_back(Point3D(pos[0], pos[1], pos[2]));
-  vertices.push_back(Point3D(pos[0] + xySize, pos[1], pos[2]));
-  vertices.push_back(Point3D(pos[0] + xySize, pos[1] + xySize, pos[2]));
-  vertices.push_back(Point3D(pos[0], pos[1] + xySize, pos[2]));
-  vertices.push_back(Point3D(pos[0], pos[1], pos[2] + zSize));
-  vertices.push_back(Point3D(pos[0] + xySize, pos[1], pos[2] + zSize));
-  vertices.push_back(Point3D(pos[0] + xySize, pos[1] + xySize, pos[2] + zSize));
-  vertices.push_back(Point3D(pos[0], pos[1] + xySize, pos[2] + zSize));
-
-  std::vector<std::vector<int> > f;
-  int faces[6][4] = { {3, 2, 1, 0}, // Front
-                      {0, 1, 5, 4}, // Bottom
-                      {2, 6, 5, 1}, // Right
-                      {7, 3, 0, 4}, // Left
-                      {7, 6, 2, 3}, // Top
-                      {4, 5, 6, 7}}; // Back
-  for (int i = 0; i < 6; i++) f.push_back(std::vector<int> (faces[i], faces[i] + 4));
-
-  return new Mesh(vertices, f);
+BoundingBox Cylinder::getBounds() const
+{
+  return BoundingBox(Point3D(-1.0, -1.0, 0.0), Point3D(1.0, 1.0, 1.0));
 }
 
 
@@ -2,29 +2,40 @@
 #define CS488_PRIMITIVE_HPP
 
 #include "algebra.hpp"
-#include <list>
 #include <iosfwd>
 #include "shapes.hpp"
-
-class Mesh;
+#include "boundingbox.hpp"
+#include "bvh.hpp"
 
 class Primitive {
  public:
   virtual ~Primitive();
   virtual bool filteredIntersect(const Point3D& eye, const Vector3D& ray,
-                                 std::list<IntersectionPoint>& tVals) const;
+                                 HitList& tVals) const;
   virtual bool intersect(const Point3D& eye, const Vector3D& ray,
-                         std::list<IntersectionPoint>& tVals) const = 0;
+                         HitList& tVals) const = 0;
+  // Whether the ray crosses the surface anywhere between tMin and tMax.
+  // Used for shadow rays, so overrides should avoid computing normals.
+  virtual bool anyHit(const Point3D& eye, const Vector3D& ray,
+                      const double tMin, const double tMax) const;
+  // filteredIntersect for each ray of the packet set in lanes, into
+  // hits[lane]. Spheres, boxes and meshes trace the rays side by side,
+  // anything else one at a time.
+  virtual void intersectPacket(const RayPacket& packet, const int lanes, HitList hits[]) const;
   virtual bool containsPoint(const Point3D& p) const = 0;
   virtual Point2D textureMapCoords(const Point3D& p) const = 0;
   virtual Vector3D getNormal(const Point3D& p) const = 0;
 
-  virtual Mesh* getBoundingBox() const = 0;
+  // Axis aligned bounds of the primitive in its own coordinates.
+  virtual BoundingBox getBounds() const = 0;
 
  protected:
+  // Sorts the hits and drops the duplicates left by a ray crossing an edge.
+  void filterHits(const Point3D& eye, const Vector3D& ray, HitList& tValues) const;
+
   bool checkQuadraticRoots(const Point3D& eye, const Vector3D& ray,
                            const double A, const double B, const double C,
-                           std::list<IntersectionPoint>& tVals) const;
+                           HitList& tVals) const;
 
   virtual bool checkPoint(const Point3D& poi) const;
 };
@@ -38,46 +49,85 @@ public:
   virtual ~NonhierSphere();
 
   bool intersect(const Point3D& eye, const Vector3D& ray, 
-                 std::list<IntersectionPoint>& tVals) const;
+                 HitList& tVals) const;
+  bool anyHit(const Point3D& eye, const Vector3D& ray, const double tMin, const double tMax) const;
+  void intersectPacket(const RayPacket& packet, const int lanes, HitList hits[]) const;
   bool containsPoint(const Point3D& p) const;
   Vector3D getNormal(const Point3D& p) const;
   Point2D textureMapCoords(const Point3D& p) const;
 
-  Mesh* getBoundingBox() const;
+  BoundingBox getBounds() const;
+
+  const Point3D& getPosition() const { return m_pos; }
+  double getRadius() const { return m_radius; }
 
 private:
   Point3D m_pos;
   double m_radius;
 };
 
-// A polygonal mesh.
+// A polygonal mesh, cut into triangles as it's loaded.
 class Mesh : public Primitive {
 public:
   Mesh();
   Mesh(const std::vector<Point3D>& verts,
-       const std::vector< std::vector<int> >& faces,
-       const std::vector<Vector3D>& upVectors = std::vector<Vector3D>() );
+       const std::vector< std::vector<int> >& faces);
 
   typedef std::vector<int> Face;
+
+  // normalFaces and uvFaces give the vertex normal and texture coordinate
+  // of each corner of the matching face. Either list, or any face in them,
+  // may be empty.
+  Mesh(const std::vector<Point3D>& verts, const std::vector<Face>& faces,
+       const std::vector<Vector3D>& normals, const std::vector<Face>& normalFaces,
+       const std::vector<Point2D>& uvs, const std::vector<Face>& uvFaces);
   
+  bool filteredIntersect(const Point3D& eye, const Vector3D& ray,
+                         HitList& tVals) const;
   bool intersect(const Point3D& eye, const Vector3D& ray,  Point3D& poi) const;
   bool intersect(const Point3D& eye, const Vector3D& ray, 
-                 std::list<IntersectionPoint>& tVals) const;
+                 HitList& tVals) const;
+  bool anyHit(const Point3D& eye, const Vector3D& ray, const double tMin, const double tMax) const;
+  void intersectPacket(const RayPacket& packet, const int lanes, HitList hits[]) const;
   bool containsPoint(const Point3D& p) const;
   Vector3D getNormal(const Point3D& p) const;
   Point2D textureMapCoords(const Point3D& p) const;
 
-  Mesh* getBoundingBox() const;
-  void transform(const Matrix4x4& m);
-  void getExtremePoints(double points[6]) const;
+  BoundingBox getBounds() const;
+
+  // Saves or restores everything built while loading the mesh.
+  void write(CacheWriter& cache) const;
+  bool read(CacheReader& cache);
 
 private:
-  const Polygon& determinePolygon(const Point3D& p) const;
+  // Plane and texture coordinate frame of one of the original faces,
+  // shared by the triangles cut from it.
+  struct FaceFrame {
+    FaceFrame() {}
+    FaceFrame(const std::vector<Point3D>& verts, const Face& face);
+
+    Point3D m_origin;
+    Vector3D m_normal;
+    Vector3D m_up;
+    Vector3D m_right;
+    double m_minX, m_minY;
+    double m_width, m_height;
+  };
+
+  void addFaces(const std::vector<Face>& faces, const std::vector<Face>& normalFaces,
+                const std::vector<Face>& uvFaces);
+  const Triangle& determineTriangle(const Point3D& p) const;
+  void buildBVH();
+  void buildBoundingSphere();
 
   std::vector<Point3D> m_verts;
+  std::vector<Vector3D> m_normals;
+  std::vector<Point2D> m_uvs;
+  std::vector<Triangle> m_triangles;
+  std::vector<FaceFrame> m_faces;
 
-  // TODO: Provide option to pass pointers to Polygons to save space.
-  std::vector<Polygon> m_polygons;
+  // Hierarchy over m_triangles.
+  BVH m_bvh;
 
   NonhierSphere m_boundingSphere;
 
@@ -90,15 +140,20 @@ public:
   virtual ~NonhierBox();
 
   bool intersect(const Point3D& eye, const Vector3D& ray, 
-                 std::list<IntersectionPoint>& tVals) const;
+                 HitList& tVals) const;
+  bool anyHit(const Point3D& eye, const Vector3D& ray, const double tMin, const double tMax) const;
+  void intersectPacket(const RayPacket& packet, const int lanes, HitList hits[]) const;
   bool containsPoint(const Point3D& p) const;
   Vector3D getNormal(const Point3D& p) const;
   Point2D textureMapCoords(const Point3D& p) const;
 
-  Mesh* getBoundingBox() const;
+  BoundingBox getBounds() const;
 
 private:
-  Mesh m_box;
+  // Index of the face p lies on, ordered -x, +x, -y, +y, -z, +z.
+  int determineFace(const Point3D& p) const;
+
+  BoundingBox m_box;
 };
 
 class Sphere : public Primitive {
@@ -109,12 +164,14 @@ public:
   virtual ~Sphere();
 
   bool intersect(const Point3D& eye, const Vector3D& ray, 
-                 std::list<IntersectionPoint>& tVals) const;
+                 HitList& tVals) const;
+  bool anyHit(const Point3D& eye, const Vector3D& ray, const double tMin, const double tMax) const;
+  void intersectPacket(const RayPacket& packet, const int lanes, HitList hits[]) const;
   bool containsPoint(const Point3D& p) const;
   Vector3D getNormal(const Point3D& p) const;
   Point2D textureMapCoords(const Point3D& p) const;
 
-  Mesh* getBoundingBox() const;
+  BoundingBox getBounds() const;
 
 private:
   NonhierSphere m_unitSphere;
@@ -131,12 +188,14 @@ class Cube : public Primitive {
   virtual ~Cube();
 
   bool intersect(const Point3D& eye, const Vector3D& ray, 
-                 std::list<IntersectionPoint>& tVals) const;
+                 HitList& tVals) const;
+  bool anyHit(const Point3D& eye, const Vector3D& ray, const double tMin, const double tMax) const;
+  void intersectPacket(const RayPacket& packet, const int lanes, HitList hits[]) const;
   bool containsPoint(const Point3D& p) const;
   Vector3D getNormal(const Point3D& p) const;
   Point2D textureMapCoords(const Point3D& p) const;
 
-  Mesh* getBoundingBox() const;
+  BoundingBox getBounds() const;
 
  private:
   NonhierBox m_unitCube;
@@ -152,12 +211,12 @@ class Cone : public Primitive {
   virtual ~Cone();
 
   bool intersect(const Point3D& eye, const Vector3D& ray, 
-                 std::list<IntersectionPoint>& tVals) const;
+                 HitList& tVals) const;
   bool containsPoint(const Point3D& p) const;
   Vector3D getNormal(const Point3D& p) const;
   Point2D textureMapCoords(const Point3D& p) const;
 
-  Mesh* getBoundingBox() const;
+  BoundingBox getBounds() const;
 
  protected:
   bool checkPoint(const Point3D& poi) const;
@@ -178,12 +237,12 @@ class Cylinder : public Primitive {
   virtual ~Cylinder();
 
   bool intersect(const Point3D& eye, const Vector3D& ray, 
-                 std::list<IntersectionPoint>& tVals) const;
+                 HitList& tVals) const;
   bool containsPoint(const Point3D& p) const;
   Vector3D getNormal(const Point3D& p) const;
   Point2D textureMapCoords(const Point3D& p) const;
 
-  Mesh* getBoundingBox() const;
+  BoundingBox getBounds() const;
 
  protected:
   bool checkPoint(const Point3D& poi) const;
@@ -0,0 +1,46 @@
+#include "random.hpp"
+
+// Mixes the bits of x so nearby inputs give unrelated seeds (splitmix64).
+static uint64_t mix(uint64_t x)
+{
+  x += 0x9e3779b97f4a7c15ULL;
+  x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+  return x ^ (x >> 31);
+}
+
+Random::Random(const uint64_t seed, const uint64_t stream)
+  : m_state(0), m_inc(1)
+{
+  this->seed(seed, stream);
+}
+
+void Random::seed(const uint64_t seed, const uint64_t stream)
+{
+  m_state = 0;
+  m_inc = (stream << 1) | 1;
+  next();
+  m_state += seed;
+  next();
+}
+
+void Random::seed(const int x, const int y, const int sample)
+{
+  uint64_t pixel = ((uint64_t)(uint32_t)y << 32) | (uint32_t)x;
+  seed(mix(pixel), mix(pixel ^ mix(sample)));
+}
+
+uint32_t Random::next()
+{
+  uint64_t old = m_state;
+  m_state = old * 6364136223846793005ULL + m_inc;
+
+  uint32_t xorShifted = ((old >> 18) ^ old) >> 27;
+  uint32_t rot = old >> 59;
+  return (xorShifted >> rot) | (xorShifted << ((-rot) & 31));
+}
+
+double Random::nextDouble()
+{
+  return next() * (1.0 / 4294967296.0);
+}
@@ -0,0 +1,31 @@
+#ifndef RANDOM_HPP
+#define RANDOM_HPP
+
+#include <stdint.h>
+
+/*
+  A small PCG32 random number generator.
+  Unlike rand() it has no shared state, so every render thread owns one
+  and sampling doesn't serialize on the C library's lock.
+*/
+class Random {
+ public:
+  Random(const uint64_t seed = 0, const uint64_t stream = 0);
+
+  void seed(const uint64_t seed, const uint64_t stream = 0);
+
+  // Seeds the generator from a pixel and sample number so the sequence
+  // doesn't depend on which thread renders the pixel.
+  void seed(const int x, const int y, const int sample);
+
+  uint32_t next();
+
+  // Uniform in [0, 1)
+  double nextDouble();
+
+ private:
+  uint64_t m_state;
+  uint64_t m_inc;
+};
+
+#endif
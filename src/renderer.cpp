@@ -1,7 +1,23 @@
 #include "renderer.hpp"
+#include "cache.hpp"
+#include "stats.hpp"
 #include <iostream>
+#include <csignal>
 #include <pthread.h>
+#include <sys/time.h>
 #include <vector>
+#include <algorithm>
+#include <cmath>
+
+static const int TILE_SIZE = 16;
+
+static double currentTime()
+{
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+
+  return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
 
 /*
   Wrapper types and functions for the creation of new threads
@@ -9,34 +25,117 @@
 
 struct Args {
   Renderer* renderer;
-  int startRow;
-  int stepSize;
+  int thread;
 };
 
 void* startThread(void* data)
 {
   struct Args* args = (struct Args*)data;
-  args->renderer->renderRows(args->startRow, args->stepSize);
+  args->renderer->renderTiles(args->thread);
 
   return NULL;
 }
 
+/*
+  *************** PixelEstimate **************
+*/
+
+static double luminance(const Colour& c)
+{
+  return 0.299 * c.R() + 0.587 * c.G() + 0.114 * c.B();
+}
+
+void PixelEstimate::add(const Colour& sample, const double weight)
+{
+  double lum = luminance(sample);
+
+  m_colour = m_colour + weight * sample;
+  m_weight += weight;
+  m_lum += lum;
+  m_lumSquared += lum * lum;
+  m_samples++;
+}
+
+Colour PixelEstimate::mean() const
+{
+  return (1.0 / m_weight) * m_colour;
+}
+
+double PixelEstimate::meanLuminance() const
+{
+  return m_lum / m_samples;
+}
+
+double PixelEstimate::error() const
+{
+  if (m_samples < 2) {
+    return 0.0;
+  }
+
+  double mean = meanLuminance();
+  double variance = (m_lumSquared - m_samples * mean * mean) / (m_samples - 1);
+  return sqrt(std::max(variance, 0.0) / m_samples);
+}
+
 /*
   *************** Renderer **************
 */
 
 Renderer::Renderer(const Scene* scene) :
   m_scene(scene),
-  m_img(m_scene->width, m_scene->height, 3)
+  m_img(m_scene->width, m_scene->height, 3),
+  m_deterministic(false),
+  m_costMetric(COST_NONE),
+  m_costFile(),
+  m_costs(),
+  m_scheduler(NULL),
+  m_stats(),
+  m_randoms(),
+  m_tilesDone(0)
 {
+  pthread_mutex_init(&m_progressLock, NULL);
 }
 
 Renderer::~Renderer()
 {
+  pthread_mutex_destroy(&m_progressLock);
 }
 
 void Renderer::render(const std::string& filename, const int numThreads)
 {
+  double startTime = currentTime();
+
+  m_stats.assign(numThreads, ThreadStats());
+
+  // Each thread's generator carries on from one pass to the next, so later
+  // passes take new samples rather than repeating the first pass's.
+  uint64_t seed = (uint64_t)(1000000.0 * startTime);
+  m_randoms.clear();
+  for (int i = 0; i < numThreads; i++) {
+    m_randoms.push_back(Random(seed, i));
+  }
+
+  startPhase(PHASE_RENDER);
+  do {
+    renderPass(numThreads);
+  } while (passFinished(filename));
+
+  std::cerr << "done" << std::endl;
+  printStats(currentTime() - startTime);
+  renderFinished();
+  endPhase(PHASE_RENDER);
+
+  startPhase(PHASE_ENCODE);
+  m_img.savePng(filename);
+  saveCostHeatmap();
+  endPhase(PHASE_ENCODE);
+}
+
+void Renderer::renderPass(const int numThreads)
+{
+  m_scheduler = new TileScheduler(m_scene->width, m_scene->height, TILE_SIZE, numThreads);
+  m_tilesDone = 0;
+
   std::vector<pthread_t*> threads;
   struct Args* data = new Args[numThreads];
   for (int i = 0; i < numThreads; i++) {
@@ -44,8 +143,7 @@ void Renderer::render(const std::string& filename, const int numThreads)
     threads.push_back(thread);
 
     data[i].renderer = this;
-    data[i].startRow = i;
-    data[i].stepSize = numThreads;
+    data[i].thread = i;
     pthread_create(thread, NULL, &startThread, (void *)&data[i]);
   }
 
@@ -54,28 +152,164 @@ void Renderer::render(const std::string& filename, const int numThreads)
     delete *it;
   }
   delete [] data;
-  
-  m_img.savePng(filename);
+  delete m_scheduler;
+  m_scheduler = NULL;
 }
 
-void Renderer::renderRows(const int startRow, const int stepSize)
+void Renderer::renderTiles(const int thread)
 {
-  int threadNo = startRow +1; 
-  int numRows = m_scene->height / stepSize;
+  ThreadStats& stats = m_stats[thread];
+  Random& random = m_randoms[thread];
+  startThreadStats();
 
-  for (int y = startRow; y < m_scene->height; y+= stepSize) {
-    for (int x = 0; x < m_scene->width; x++) {
-      Colour c = getPixelColour(x, y);
-      m_img(x, y, 0) = c.R();
-      m_img(x, y, 1) = c.G();
-      m_img(x, y, 2) = c.B();
+  Tile tile;
+  bool stolen;
+  while (m_scheduler->nextTile(thread, tile, stolen)) {
+    double tileStart = currentTime();
+    renderTile(tile, random);
+    stats.m_busyTime += currentTime() - tileStart;
+
+    stats.m_tiles++;
+    if (stolen) {
+      stats.m_stolen++;
     }
-    if ((y / stepSize) % (numRows / 4) == 0) {
-      std::cerr << "Thread " << threadNo << ": " << 25 * ((y / stepSize) / (numRows / 4)) << "% ";
+
+    reportProgress();
+  }
+}
+
+void Renderer::renderTile(const Tile& tile, Random& random)
+{
+  for (int y = tile.y0; y < tile.y1; y++) {
+    for (int x = tile.x0; x < tile.x1; x++) {
+      double start = costReading();
+      seedPixel(random, x, y, 0);
+      setPixel(x, y, getPixelColour(x, y, random));
+      addPixelCost(x, y, costReading() - start);
     }
   }
-  std::cerr << "Thread " << threadNo << " done" << std::endl;
 }
+
+void Renderer::seedPixel(Random& random, const int x, const int y, const int sample) const
+{
+  if (m_deterministic) {
+    random.seed(x, y, sample);
+  }
+}
+
+void Renderer::setPixel(const int x, const int y, const Colour& c)
+{
+  m_img(x, y, 0) = c.R();
+  m_img(x, y, 1) = c.G();
+  m_img(x, y, 2) = c.B();
+}
+
+void Renderer::setCostHeatmap(const CostMetric metric, const std::string& filename)
+{
+  m_costMetric = metric;
+  m_costFile = filename;
+  m_costs.assign(metric == COST_NONE ? 0 : m_scene->width * m_scene->height, 0.0);
+
+  // Tests are read from the render threads' stats counters.
+  if (metric == COST_TESTS) {
+    enableStats();
+  }
+}
+
+double Renderer::costReading() const
+{
+  switch (m_costMetric) {
+  case COST_TIME:
+    return 1000000.0 * currentTime();
+  case COST_TESTS:
+    return threadIntersectionTests();
+  default:
+    return 0.0;
+  }
+}
+
+void Renderer::addPixelCost(const int x, const int y, const double cost)
+{
+  if (m_costMetric != COST_NONE) {
+    m_costs[y * m_scene->width + x] += cost;
+  }
+}
+
+// Black through blue, red and yellow to white as t goes from 0 to 1.
+static Colour heatColour(const double t)
+{
+  static const Colour stops[] = { Colour(0.0, 0.0, 0.0), Colour(0.0, 0.0, 1.0),
+                                  Colour(1.0, 0.0, 0.0), Colour(1.0, 1.0, 0.0),
+                                  Colour(1.0, 1.0, 1.0) };
+  static const int numStops = sizeof(stops) / sizeof(stops[0]);
+
+  double pos = std::min(std::max(t, 0.0), 1.0) * (numStops - 1);
+  int i = std::min((int)pos, numStops - 2);
+  double f = pos - i;
+  return (1.0 - f) * stops[i] + f * stops[i + 1];
+}
+
+void Renderer::saveCostHeatmap() const
+{
+  if (m_costMetric == COST_NONE) {
+    return;
+  }
+
+  // Scale to the 99th percentile so a few very expensive pixels don't
+  // leave the rest of the image black.
+  std::vector<double> sorted(m_costs);
+  std::sort(sorted.begin(), sorted.end());
+  double scale = sorted[(sorted.size() - 1) * 99 / 100];
+  if (scale <= 0.0) {
+    scale = std::max(sorted.back(), 1.0);
+  }
+
+  Image heatmap(m_scene->width, m_scene->height, 3);
+  for (int y = 0; y < m_scene->height; y++) {
+    for (int x = 0; x < m_scene->width; x++) {
+      Colour c = heatColour(m_costs[y * m_scene->width + x] / scale);
+      heatmap(x, y, 0) = c.R();
+      heatmap(x, y, 1) = c.G();
+      heatmap(x, y, 2) = c.B();
+    }
+  }
+  heatmap.savePng(m_costFile);
+
+  std::cerr << "Cost heatmap saved to " << m_costFile << ", white is "
+            << scale << (m_costMetric == COST_TIME ? " microseconds" : " intersection tests")
+            << " or more per pixel" << std::endl;
+}
+
+void Renderer::reportProgress()
+{
+  pthread_mutex_lock(&m_progressLock);
+  int numTiles = m_scheduler->numTiles();
+  int before = 4 * m_tilesDone / numTiles;
+  m_tilesDone++;
+  int after = 4 * m_tilesDone / numTiles;
+  if (after != before && m_tilesDone != numTiles) {
+    std::cerr << 25 * after << "% ";
+  }
+  pthread_mutex_unlock(&m_progressLock);
+}
+
+void Renderer::printStats(const double wallTime) const
+{
+  double totalBusy = 0.0;
+  for (size_t i = 0; i < m_stats.size(); i++) {
+    const ThreadStats& stats = m_stats[i];
+    std::cerr << "Thread " << i + 1 << ": " << stats.m_tiles << " tiles (" 
+              << stats.m_stolen << " stolen), busy " << stats.m_busyTime << "s ("
+              << (wallTime > 0.0 ? (int)(100.0 * stats.m_busyTime / wallTime) : 100)
+              << "%)" << std::endl;
+    totalBusy += stats.m_busyTime;
+  }
+
+  std::cerr << "Render time: " << wallTime << "s, parallel efficiency: "
+            << (wallTime > 0.0 ? (int)(100.0 * totalBusy / (wallTime * m_stats.size())) : 100)
+            << "%" << std::endl;
+}
+
 /*
   *************** BasicRenderer **************
 */
@@ -89,80 +323,433 @@ BasicRenderer::~BasicRenderer()
 {
 }
 
-Colour BasicRenderer::getPixelColour(const int x, const int y)
+Colour BasicRenderer::getPixelColour(const int x, const int y, Random& random)
 {
+  (void)random;
+
   Colour c = m_scene->getBackground(x, y);
   m_scene->intersect(((double)m_scene->width / 2.0) - (double)x, ((double)m_scene->height / 2.0) - (double)y, c);
   return c;
 }
 
+void BasicRenderer::renderTile(const Tile& tile, Random& random)
+{
+  (void)random;
+
+  for (int y = tile.y0; y < tile.y1; y++) {
+    for (int x = tile.x0; x < tile.x1; x += PACKET_SIZE) {
+      const int count = std::min(PACKET_SIZE, tile.x1 - x);
+
+      Vector3D rays[PACKET_SIZE];
+      for (int i = 0; i < count; i++) {
+        rays[i] = m_scene->getRay(((double)m_scene->width / 2.0) - (double)(x + i),
+                                  ((double)m_scene->height / 2.0) - (double)y);
+      }
+
+      // Shading spawns rays in all directions, so it goes back to one ray at a time.
+      IntersectionPoint pois[PACKET_SIZE];
+      double start = costReading();
+      const int hits = m_scene->intersect(RayPacket(m_scene->getEye(), rays, count), pois);
+      // The packet's pixels share the cost of tracing it.
+      const double packetShare = (costReading() - start) / count;
+      for (int i = 0; i < count; i++) {
+        start = costReading();
+        if (hits & (1 << i)) {
+          setPixel(x + i, y, pois[i].m_owner->getColour(m_scene->getEye(), pois[i]));
+        } else {
+          setPixel(x + i, y, m_scene->getBackground(x + i, y));
+        }
+        addPixelCost(x + i, y, costReading() - start + packetShare);
+      }
+    }
+  }
+}
+
 /*
   *************** StochasticRenderer **************
 */
 
-StochasticRenderer::StochasticRenderer(const Scene* scene) :
+StochasticRenderer::StochasticRenderer(const Scene* scene, const Sampler* sampler) :
   Renderer(scene),
-  RAYS_PER_PIXEL(16)
+  m_sampler(sampler)
 {
 }
 
 StochasticRenderer::~StochasticRenderer()
 {
+  delete m_sampler;
 }
 
-Colour StochasticRenderer::getPixelColour(const int x, const int y)
+Colour StochasticRenderer::getPixelColour(const int x, const int y, Random& random)
+{
+  PixelEstimate estimate;
+  samplePixel(x, y, random, estimate);
+
+  return estimate.mean();
+}
+
+void StochasticRenderer::samplePixel(const int x, const int y, Random& random,
+                                     PixelEstimate& estimate) const
 {
   // Stocastic Sampling.
-  // Break the pixel into subpixels and cast a random ray in each subpixel.
+  // Cast a ray through each sample position in the pixel.
   // Weight the samples using a gaussian distribution based on distance from pixel.
   double pixelY = ((double)m_scene->height / 2) - (double)y;
   double pixelX = ((double)m_scene->width / 2) - (double)x;
 
-  int gridSize = sqrt(RAYS_PER_PIXEL);
-  double stepSize = 1.0 / (double)gridSize;
+  Point2D samples[Sampler::MAX_SAMPLES];
+  m_sampler->generate(samples, random);
 
-  Colour c(0.0);
-  double totalWeight = 0;
-  for (int subY = 0; subY < gridSize; subY++) {
-    for (int subX = 0; subX < gridSize; subX++) {
-      double xOff = (((double)rand() / (double)RAND_MAX - 0.5) / gridSize) + 
-                    stepSize * (double)subX - 0.5 + stepSize / 2.0; 
-      double yOff = (((double)rand() / (double)RAND_MAX - 0.5) / gridSize) +
-                    stepSize * (double)subX - 0.5 + stepSize / 2.0;
-
-      double dx = pixelX + xOff;
-      double dy = pixelY + xOff;
-
-      // Now we intersect this ray with our scene and get a colour back.
-      Colour sample = m_scene->getBackground(x, y);
-      m_scene->intersect(dx, dy, sample);
-
-      double distSquared = xOff * xOff + yOff * yOff; 
-      double weight = (1.0 / sqrt(2 * M_PI)) * exp(-1.0/2.0 * distSquared);
-      c = c + weight * sample;
-      totalWeight += weight;
+  for (int i = 0; i < m_sampler->numSamples(); i++) {
+    double xOff = samples[i][0] - 0.5;
+    double yOff = samples[i][1] - 0.5;
+
+    double dx = pixelX + xOff;
+    double dy = pixelY + yOff;
+
+    // Now we intersect this ray with our scene and get a colour back.
+    Colour sample = m_scene->getBackground(x, y);
+    m_scene->intersect(dx, dy, sample);
+
+    double distSquared = xOff * xOff + yOff * yOff; 
+    double weight = (1.0 / sqrt(2 * M_PI)) * exp(-1.0/2.0 * distSquared);
+    estimate.add(sample, weight);
+  }
+}
+
+/*
+  *************** AdaptiveRenderer **************
+*/
+
+// Pixels whose mean luminance differs from a neighbour's by more than this
+// always get at least one more batch, since a small first batch can miss an
+// edge crossing the pixel entirely.
+static const double CONTRAST_THRESHOLD = 0.1;
+
+AdaptiveRenderer::AdaptiveRenderer(const Scene* scene, const Sampler* sampler, const int maxSamples,
+                                   const double threshold, const std::string& sampleCountFile) :
+  StochasticRenderer(scene, sampler),
+  m_maxSamples(std::max(maxSamples, sampler->numSamples())),
+  m_threshold(threshold),
+  m_sampleCountFile(sampleCountFile),
+  m_sampleCounts(m_scene->width * m_scene->height, 0),
+  m_refining(false),
+  m_estimates(m_scene->width * m_scene->height),
+  m_highContrast(m_scene->width * m_scene->height, false)
+{
+}
+
+AdaptiveRenderer::~AdaptiveRenderer()
+{
+}
+
+void AdaptiveRenderer::renderTile(const Tile& tile, Random& random)
+{
+  if (!m_refining) {
+    // First batch everywhere.
+    for (int y = tile.y0; y < tile.y1; y++) {
+      for (int x = tile.x0; x < tile.x1; x++) {
+        double start = costReading();
+        seedPixel(random, x, y, 0);
+        samplePixel(x, y, random, m_estimates[y * m_scene->width + x]);
+        addPixelCost(x, y, costReading() - start);
+      }
     }
+    return;
   }
-  c = (1.0 / totalWeight) * c;
 
-  return c;
+  int batchSize = m_sampler->numSamples();
+  for (int y = tile.y0; y < tile.y1; y++) {
+    for (int x = tile.x0; x < tile.x1; x++) {
+      int i = y * m_scene->width + x;
+      PixelEstimate& estimate = m_estimates[i];
+
+      int pass = 1;
+      bool refine = m_highContrast[i];
+      double start = costReading();
+      while (estimate.m_samples + batchSize <= m_maxSamples &&
+             (refine || estimate.error() > m_threshold)) {
+        seedPixel(random, x, y, pass++);
+        samplePixel(x, y, random, estimate);
+        refine = false;
+      }
+      addPixelCost(x, y, costReading() - start);
+
+      setPixel(x, y, estimate.mean());
+      m_sampleCounts[i] = estimate.m_samples;
+    }
+  }
+}
+
+bool AdaptiveRenderer::passFinished(const std::string& filename)
+{
+  (void)filename;
+
+  if (m_refining) {
+    return false;
+  }
+
+  // Compare every pixel against its neighbours, across tile borders too,
+  // before any pixel is refined, so the result doesn't depend on the order
+  // pixels are visited in.
+  const int width = m_scene->width;
+  const int height = m_scene->height;
+  for (int y = 0; y < height; y++) {
+    for (int x = 0; x < width; x++) {
+      double lum = m_estimates[y * width + x].meanLuminance();
+      double contrast = 0.0;
+      if (x > 0) {
+        contrast = std::max(contrast, fabs(lum - m_estimates[y * width + x - 1].meanLuminance()));
+      }
+      if (x < width - 1) {
+        contrast = std::max(contrast, fabs(lum - m_estimates[y * width + x + 1].meanLuminance()));
+      }
+      if (y > 0) {
+        contrast = std::max(contrast, fabs(lum - m_estimates[(y - 1) * width + x].meanLuminance()));
+      }
+      if (y < height - 1) {
+        contrast = std::max(contrast, fabs(lum - m_estimates[(y + 1) * width + x].meanLuminance()));
+      }
+      m_highContrast[y * width + x] = contrast > CONTRAST_THRESHOLD;
+    }
+  }
+
+  std::cerr << "refining ";
+  m_refining = true;
+  return true;
+}
+
+void AdaptiveRenderer::renderFinished()
+{
+  long totalSamples = 0;
+  for (std::vector<int>::const_iterator it = m_sampleCounts.begin(); it != m_sampleCounts.end(); it++) {
+    totalSamples += *it;
+  }
+  std::cerr << "Average samples per pixel: " 
+            << (double)totalSamples / m_sampleCounts.size() << " (max " << m_maxSamples << ")" 
+            << std::endl;
+
+  if (m_sampleCountFile.empty()) {
+    return;
+  }
+
+  Image counts(m_scene->width, m_scene->height, 1);
+  for (int y = 0; y < m_scene->height; y++) {
+    for (int x = 0; x < m_scene->width; x++) {
+      counts(x, y, 0) = (double)m_sampleCounts[y * m_scene->width + x] / m_maxSamples;
+    }
+  }
+  counts.savePng(m_sampleCountFile);
+}
+
+/*
+  *************** ProgressiveRenderer **************
+*/
+
+// Set when the render should stop at the end of the current pass.
+static volatile sig_atomic_t s_interrupted = 0;
+
+static void interrupt(int sig)
+{
+  s_interrupted = 1;
+  // A second signal kills the render without saving.
+  signal(sig, SIG_DFL);
+}
+
+ProgressiveRenderer::ProgressiveRenderer(const Scene* scene, const Sampler* sampler,
+                                         const int maxPasses, const double interval,
+                                         const std::string& checkpointFile, const uint64_t key) :
+  StochasticRenderer(scene, sampler),
+  m_maxPasses(std::max(maxPasses, 0)),
+  m_interval(interval),
+  m_checkpointFile(checkpointFile),
+  m_key(key),
+  m_passes(0),
+  m_lastSave(currentTime()),
+  m_estimates(m_scene->width * m_scene->height),
+  m_startTime(currentTime()),
+  m_timeLimit(0.0),
+  m_rayBudget(0),
+  m_rays(0),
+  m_passCut(0)
+{
+  // Checkpoints only fit renders of the same size and batch size.
+  uint64_t settings[4] = { key, (uint64_t)m_scene->width, (uint64_t)m_scene->height,
+                           (uint64_t)sampler->numSamples() };
+  m_key = hashBytes((const char*)settings, sizeof(settings));
+
+  // Pixels stay black in previews until their first samples are taken.
+  for (int y = 0; y < m_scene->height; y++) {
+    for (int x = 0; x < m_scene->width; x++) {
+      setPixel(x, y, Colour(0.0));
+    }
+  }
+  loadCheckpoint();
+
+  s_interrupted = 0;
+  signal(SIGINT, interrupt);
+  signal(SIGTERM, interrupt);
+}
+
+ProgressiveRenderer::~ProgressiveRenderer()
+{
+  signal(SIGINT, SIG_DFL);
+  signal(SIGTERM, SIG_DFL);
+}
+
+void ProgressiveRenderer::setBudget(const double timeLimit, const long rayBudget)
+{
+  m_timeLimit = std::max(timeLimit, 0.0);
+  m_rayBudget = std::max(rayBudget, 0L);
+}
+
+long ProgressiveRenderer::raysCast() const
+{
+  // Render threads add to the count while others check it against the budget.
+  return __atomic_load_n(&m_rays, __ATOMIC_RELAXED);
+}
+
+bool ProgressiveRenderer::budgetSpent() const
+{
+  return (m_timeLimit > 0.0 && currentTime() - m_startTime >= m_timeLimit) ||
+         (m_rayBudget > 0 && raysCast() >= m_rayBudget);
+}
+
+void ProgressiveRenderer::renderTile(const Tile& tile, Random& random)
+{
+  // Leave the rest of a stopped pass for the next render.
+  if (s_interrupted || budgetSpent()) {
+    __atomic_store_n(&m_passCut, 1, __ATOMIC_RELAXED);
+    return;
+  }
+
+  int passes = m_passes + 1;
+  if (m_maxPasses > 0) {
+    passes = std::min(passes, m_maxPasses);
+  }
+
+  int batchSize = m_sampler->numSamples();
+  long rays = 0;
+  for (int y = tile.y0; y < tile.y1; y++) {
+    for (int x = tile.x0; x < tile.x1; x++) {
+      PixelEstimate& estimate = m_estimates[y * m_scene->width + x];
+
+      // Pixels cut short by a stopped render catch up here.
+      double start = costReading();
+      while (estimate.m_samples < passes * batchSize) {
+        seedPixel(random, x, y, estimate.m_samples / batchSize);
+        samplePixel(x, y, random, estimate);
+        rays += batchSize;
+      }
+      addPixelCost(x, y, costReading() - start);
+
+      setPixel(x, y, estimate.mean());
+    }
+  }
+
+  __sync_fetch_and_add(&m_rays, rays);
+}
+
+bool ProgressiveRenderer::passFinished(const std::string& filename)
+{
+  if (!m_passCut) {
+    if (m_maxPasses == 0 || m_passes < m_maxPasses) {
+      m_passes++;
+    }
+    std::cerr << "pass " << m_passes << ", " << m_passes * m_sampler->numSamples()
+              << " samples per pixel" << std::endl;
+  }
+
+  bool stop = true;
+  if (s_interrupted) {
+    std::cerr << "Interrupted, saving what has been rendered so far" << std::endl;
+  } else if (budgetSpent()) {
+    std::cerr << (m_rayBudget > 0 && raysCast() >= m_rayBudget ? "Ray budget" : "Time limit")
+              << " reached, saving what has been rendered so far" << std::endl;
+  } else {
+    stop = m_maxPasses > 0 && m_passes >= m_maxPasses;
+  }
+  m_passCut = 0;
+
+  if (stop || currentTime() - m_lastSave >= m_interval) {
+    // The final image is saved once the render returns.
+    if (!stop) {
+      m_img.savePng(filename);
+    }
+    saveCheckpoint();
+    m_lastSave = currentTime();
+  }
+
+  return !stop;
+}
+
+void ProgressiveRenderer::renderFinished()
+{
+  long totalSamples = 0;
+  for (std::vector<PixelEstimate>::const_iterator it = m_estimates.begin(); it != m_estimates.end(); it++) {
+    totalSamples += it->m_samples;
+  }
+
+  double renderTime = currentTime() - m_startTime;
+  std::cerr << "Average samples per pixel: " << (double)totalSamples / m_estimates.size()
+            << ", " << raysCast() << " camera rays in " << renderTime << "s ("
+            << (renderTime > 0.0 ? (long)(raysCast() / renderTime) : 0) << " rays/s)" << std::endl;
+}
+
+void ProgressiveRenderer::loadCheckpoint()
+{
+  CacheReader reader(m_checkpointFile, m_key);
+
+  int passes;
+  std::vector<PixelEstimate> estimates;
+  if (!reader.read(passes) || !reader.read(estimates) || !reader.done() ||
+      estimates.size() != m_estimates.size()) {
+    return;
+  }
+
+  m_passes = passes;
+  m_estimates.swap(estimates);
+  for (int y = 0; y < m_scene->height; y++) {
+    for (int x = 0; x < m_scene->width; x++) {
+      const PixelEstimate& estimate = m_estimates[y * m_scene->width + x];
+      if (estimate.m_samples > 0) {
+        setPixel(x, y, estimate.mean());
+      }
+    }
+  }
+
+  std::cerr << "Resuming from " << m_checkpointFile << " after " << m_passes << " passes"
+            << std::endl;
+}
+
+void ProgressiveRenderer::saveCheckpoint() const
+{
+  CacheWriter writer(m_checkpointFile, m_key);
+  writer.write(m_passes);
+  writer.write(m_estimates);
+  if (!writer.close()) {
+    std::cerr << "Could not save checkpoint " << m_checkpointFile << std::endl;
+  }
 }
 
 /*
   *************** DepthOfFieldRenderer **************
 */
 
-DepthOfFieldRenderer::DepthOfFieldRenderer(const Scene* scene, const Point3D& focalPlanePoint) :
+DepthOfFieldRenderer::DepthOfFieldRenderer(const Scene* scene, const Point3D& focalPlanePoint,
+                                           const Sampler* sampler) :
   Renderer(scene),
-  m_focalPlane(m_scene->getView(), focalPlanePoint)
+  m_focalPlane(m_scene->getView(), focalPlanePoint),
+  m_sampler(sampler)
 {
 }
 
 DepthOfFieldRenderer::~DepthOfFieldRenderer()
 {
+  delete m_sampler;
 }
   
-Colour DepthOfFieldRenderer::getPixelColour(const int x, const int y)
+Colour DepthOfFieldRenderer::getPixelColour(const int x, const int y, Random& random)
 {
   double pixelY = ((double)m_scene->height / 2) - (double)y;
   double pixelX = ((double)m_scene->width / 2) - (double)x;
@@ -172,16 +759,19 @@ Colour DepthOfFieldRenderer::getPixelColour(const int x, const int y)
   Point3D eye = m_scene->getEye();
   Point3D focalPoint = eye + (m_focalPlane.intersect(eye, ray)) * ray;
 
-  static const int sampleRays = 10;
+  Point2D lensSamples[Sampler::MAX_SAMPLES];
+  m_sampler->generate(lensSamples, random);
+
   Colour c(0.0);
-  for (int i = 0; i < sampleRays; i++) {
-    Point3D offsetEye = m_scene->getJitteredEye(); 
+  for (int i = 0; i < m_sampler->numSamples(); i++) {
+    Point3D offsetEye = m_scene->getLensEye(lensSamples[i]); 
     Vector3D offsetRay = focalPoint - offsetEye; 
     
     Colour sample = m_scene->getBackground(x, y);
+    countStat(STAT_PRIMARY_RAYS);
     m_scene->intersect(offsetEye, offsetRay, sample);
     c = c + sample;
   }
 
-  return (1.0 / (double)sampleRays) * c;
+  return (1.0 / (double)m_sampler->numSamples()) * c;
 }
@@ -2,10 +2,50 @@
 #define RENDERER_HPP
 
 #include <string>
+#include <vector>
+#include <stdint.h>
+#include <pthread.h>
 #include "image.hpp"
 #include "scene.hpp"
 #include "algebra.hpp"
 #include "shapes.hpp"
+#include "tilescheduler.hpp"
+#include "random.hpp"
+#include "sampler.hpp"
+
+// What a single render thread did, reported once the render finishes.
+struct ThreadStats {
+  ThreadStats() : m_busyTime(0.0), m_tiles(0), m_stolen(0) {}
+
+  double m_busyTime;
+  int m_tiles;
+  int m_stolen;
+};
+
+// Running totals for the samples taken in one pixel.
+struct PixelEstimate {
+  PixelEstimate() : m_colour(0.0), m_weight(0.0), m_lum(0.0), m_lumSquared(0.0), m_samples(0) {}
+
+  void add(const Colour& sample, const double weight);
+
+  Colour mean() const;
+  double meanLuminance() const;
+  // Standard error of the mean luminance.
+  double error() const;
+
+  Colour m_colour;
+  double m_weight;
+  double m_lum;
+  double m_lumSquared;
+  int m_samples;
+};
+
+// What the cost heatmap measures in each pixel.
+enum CostMetric {
+  COST_NONE,
+  COST_TIME,
+  COST_TESTS
+};
 
 class Renderer {
  public:
@@ -13,46 +53,182 @@ class Renderer {
   virtual ~Renderer();
   void render(const std::string& filename, const int numThreads);
 
-  void renderRows(const int startRow, const int numRows);
+  // Seed each pixel's random numbers from its coordinates instead of
+  // using one generator per thread, making renders reproducible no matter
+  // how many threads there are.
+  void setDeterministic(const bool deterministic) { m_deterministic = deterministic; }
+
+  // Saves a false colour image of the time (in microseconds) or the number
+  // of intersection tests spent on each pixel to filename.
+  void setCostHeatmap(const CostMetric metric, const std::string& filename);
+
+  // Renders tiles from the scheduler until there are none left.
+  void renderTiles(const int thread);
 
  protected:
-  virtual Colour getPixelColour(const int x, const int y) = 0;
+  virtual Colour getPixelColour(const int x, const int y, Random& random) = 0;
+  virtual void renderTile(const Tile& tile, Random& random);
+  // Called each time every tile has been rendered. Returning true renders
+  // all the tiles again.
+  virtual bool passFinished(const std::string& filename) { (void)filename; return false; }
+  // Called once the last pass is rendered, before the image is saved.
+  virtual void renderFinished() {}
+
+  // Reseeds random for the given pixel and sample pass when rendering deterministically.
+  void seedPixel(Random& random, const int x, const int y, const int sample) const;
+  void setPixel(const int x, const int y, const Colour& c);
+
+  // The difference between two readings is the cost of the work done
+  // between them, to be added to a pixel with addPixelCost.
+  double costReading() const;
+  void addPixelCost(const int x, const int y, const double cost);
 
   const Scene* m_scene;
   Image m_img;
+
+ private:
+  void renderPass(const int numThreads);
+  void reportProgress();
+  void printStats(const double wallTime) const;
+  void saveCostHeatmap() const;
+
+  bool m_deterministic;
+
+  CostMetric m_costMetric;
+  std::string m_costFile;
+  std::vector<double> m_costs;
+
+  TileScheduler* m_scheduler;
+  std::vector<ThreadStats> m_stats;
+  // One generator per thread for the whole render.
+  std::vector<Random> m_randoms;
+
+  pthread_mutex_t m_progressLock;
+  int m_tilesDone;
 };
 
+// Traces neighbouring pixels of a row together as ray packets.
 class BasicRenderer : public Renderer {
  public:
   BasicRenderer(const Scene* scene);
   virtual ~BasicRenderer();
 
  protected:
-  virtual Colour getPixelColour(const int x, const int y);
+  virtual Colour getPixelColour(const int x, const int y, Random& random);
+  virtual void renderTile(const Tile& tile, Random& random);
 };
 
+// Takes ownership of sampler, which places the rays within each pixel.
 class StochasticRenderer : public Renderer {
  public:
-  StochasticRenderer(const Scene* scene);
+  StochasticRenderer(const Scene* scene, const Sampler* sampler);
   virtual ~StochasticRenderer();
 
  protected:
-  virtual Colour getPixelColour(const int x, const int y);
+  virtual Colour getPixelColour(const int x, const int y, Random& random);
+
+  // Casts one ray per sample position of the sampler into estimate.
+  void samplePixel(const int x, const int y, Random& random, PixelEstimate& estimate) const;
+
+  const Sampler* m_sampler;
+};
+
+/*
+  Takes one batch of samples in every pixel, then, in a second pass, keeps
+  adding batches to the pixels whose estimate is still noisy or which
+  differ a lot from their neighbours, up to maxSamples.
+  If sampleCountFile isn't empty, a greyscale image of how many samples
+  each pixel took is saved there.
+*/
+class AdaptiveRenderer : public StochasticRenderer {
+ public:
+  AdaptiveRenderer(const Scene* scene, const Sampler* sampler, const int maxSamples,
+                   const double threshold, const std::string& sampleCountFile);
+  virtual ~AdaptiveRenderer();
+
+ protected:
+  virtual void renderTile(const Tile& tile, Random& random);
+  virtual bool passFinished(const std::string& filename);
+  virtual void renderFinished();
+
+ private:
+  const int m_maxSamples;
+  const double m_threshold;
+  const std::string m_sampleCountFile;
+
+  // Samples taken in each pixel.
+  std::vector<int> m_sampleCounts;
+
+  // Set once the first batch has been taken in every pixel.
+  bool m_refining;
+  std::vector<PixelEstimate> m_estimates;
+  // Pixels differing from a neighbour by more than CONTRAST_THRESHOLD
+  // after the first batch.
+  std::vector<bool> m_highContrast;
+};
+
+/*
+  Refines the whole image in passes, each taking one more batch of samples
+  in every pixel, until maxPasses passes are done (or forever if it's 0) or
+  the render is interrupted with SIGINT or SIGTERM or its budget is spent.
+  Every interval seconds, and when it stops, the image so far is saved
+  along with a checkpoint of the samples in every pixel. A later render
+  with the same checkpointFile and key resumes from it.
+*/
+class ProgressiveRenderer : public StochasticRenderer {
+ public:
+  ProgressiveRenderer(const Scene* scene, const Sampler* sampler, const int maxPasses,
+                      const double interval, const std::string& checkpointFile,
+                      const uint64_t key);
+  virtual ~ProgressiveRenderer();
+
+  // Stops once timeLimit seconds have been spent rendering or rayBudget
+  // camera rays have been cast. Zero means no limit.
+  void setBudget(const double timeLimit, const long rayBudget);
+
+ protected:
+  virtual void renderTile(const Tile& tile, Random& random);
+  virtual bool passFinished(const std::string& filename);
+  virtual void renderFinished();
 
  private:
-  const int RAYS_PER_PIXEL;
+  long raysCast() const;
+  bool budgetSpent() const;
+  void loadCheckpoint();
+  void saveCheckpoint() const;
+
+  const int m_maxPasses;
+  const double m_interval;
+  const std::string m_checkpointFile;
+  uint64_t m_key;
+
+  // Passes finished over every pixel, including those of resumed renders.
+  int m_passes;
+  double m_lastSave;
+  std::vector<PixelEstimate> m_estimates;
+
+  double m_startTime;
+  double m_timeLimit;
+  long m_rayBudget;
+  // Camera rays cast by this render, not counting resumed ones.
+  long m_rays;
+  // Set when tiles of the current pass were skipped.
+  int m_passCut;
 };
 
+// Takes ownership of sampler, which places the eye positions on the lens.
 class DepthOfFieldRenderer : public Renderer {
  public:
-  DepthOfFieldRenderer(const Scene* scene, const Point3D& focalPlanePoint);
+  DepthOfFieldRenderer(const Scene* scene, const Point3D& focalPlanePoint,
+                       const Sampler* sampler);
   virtual ~DepthOfFieldRenderer();
 
  protected:
-  virtual Colour getPixelColour(const int x, const int y);
+  virtual Colour getPixelColour(const int x, const int y, Random& random);
 
  private:
   Plane m_focalPlane;
+  const Sampler* m_sampler;
 };
 
 #endif
@@ -0,0 +1,230 @@
+#include "sampler.hpp"
+#include <algorithm>
+#include <cmath>
+
+// Wraps x into [0, 1).
+static double wrap(const double x)
+{
+  return x - floor(x);
+}
+
+// Reverses the bits of i, which is the radical inverse in base 2 scaled by 2^32.
+static uint32_t reverseBits(uint32_t i)
+{
+  i = (i << 16) | (i >> 16);
+  i = ((i & 0x00ff00ff) << 8) | ((i & 0xff00ff00) >> 8);
+  i = ((i & 0x0f0f0f0f) << 4) | ((i & 0xf0f0f0f0) >> 4);
+  i = ((i & 0x33333333) << 2) | ((i & 0xcccccccc) >> 2);
+  i = ((i & 0x55555555) << 1) | ((i & 0xaaaaaaaa) >> 1);
+  return i;
+}
+
+// The second Sobol dimension, whose generator matrix is Pascal's triangle mod 2.
+static uint32_t sobol2(uint32_t i)
+{
+  uint32_t r = 0;
+  for (uint32_t v = 1u << 31; i; i >>= 1, v ^= v >> 1) {
+    if (i & 1) {
+      r ^= v;
+    }
+  }
+  return r;
+}
+
+static double radicalInverse(int i, const int base)
+{
+  double inverse = 1.0 / base;
+  double scale = inverse;
+  double result = 0.0;
+  while (i > 0) {
+    result += (i % base) * scale;
+    i /= base;
+    scale *= inverse;
+  }
+  return result;
+}
+
+// Fisher-Yates shuffle of values[0..n).
+static void shuffle(int* values, const int n, Random& random)
+{
+  for (int i = n - 1; i > 0; i--) {
+    std::swap(values[i], values[random.next() % (i + 1)]);
+  }
+}
+
+/*
+  *************** Sampler **************
+*/
+
+Sampler::Sampler(const int numSamples) :
+  m_numSamples(std::max(1, std::min(numSamples, (int)MAX_SAMPLES)))
+{
+}
+
+Sampler::~Sampler()
+{
+}
+
+Sampler* createSampler(const std::string& name, const int numSamples)
+{
+  if (name == "random") {
+    return new RandomSampler(numSamples);
+  } else if (name == "stratified") {
+    return new StratifiedSampler(numSamples);
+  } else if (name == "halton") {
+    return new HaltonSampler(numSamples);
+  } else if (name == "sobol") {
+    return new SobolSampler(numSamples);
+  } else if (name == "bluenoise") {
+    return new BlueNoiseSampler(numSamples);
+  }
+  return NULL;
+}
+
+/*
+  *************** RandomSampler **************
+*/
+
+RandomSampler::RandomSampler(const int numSamples) :
+  Sampler(numSamples)
+{
+}
+
+void RandomSampler::generate(Point2D* samples, Random& random) const
+{
+  for (int i = 0; i < m_numSamples; i++) {
+    samples[i][0] = random.nextDouble();
+    samples[i][1] = random.nextDouble();
+  }
+}
+
+/*
+  *************** StratifiedSampler **************
+*/
+
+StratifiedSampler::StratifiedSampler(const int numSamples) :
+  Sampler(numSamples)
+{
+}
+
+void StratifiedSampler::generate(Point2D* samples, Random& random) const
+{
+  int gridSize = (int)(sqrt((double)m_numSamples) + 0.5);
+  if (gridSize * gridSize == m_numSamples) {
+    double stepSize = 1.0 / gridSize;
+    for (int subY = 0; subY < gridSize; subY++) {
+      for (int subX = 0; subX < gridSize; subX++) {
+        Point2D& sample = samples[subY * gridSize + subX];
+        sample[0] = (subX + random.nextDouble()) * stepSize;
+        sample[1] = (subY + random.nextDouble()) * stepSize;
+      }
+    }
+    return;
+  }
+
+  int rows[MAX_SAMPLES];
+  for (int i = 0; i < m_numSamples; i++) {
+    rows[i] = i;
+  }
+  shuffle(rows, m_numSamples, random);
+
+  double stepSize = 1.0 / m_numSamples;
+  for (int i = 0; i < m_numSamples; i++) {
+    samples[i][0] = (i + random.nextDouble()) * stepSize;
+    samples[i][1] = (rows[i] + random.nextDouble()) * stepSize;
+  }
+}
+
+/*
+  *************** HaltonSampler **************
+*/
+
+HaltonSampler::HaltonSampler(const int numSamples) :
+  Sampler(numSamples)
+{
+}
+
+void HaltonSampler::generate(Point2D* samples, Random& random) const
+{
+  double shiftX = random.nextDouble();
+  double shiftY = random.nextDouble();
+
+  // Skip index 0, which is the corner (0, 0) in every base.
+  for (int i = 0; i < m_numSamples; i++) {
+    samples[i][0] = wrap(radicalInverse(i + 1, 2) + shiftX);
+    samples[i][1] = wrap(radicalInverse(i + 1, 3) + shiftY);
+  }
+}
+
+/*
+  *************** SobolSampler **************
+*/
+
+SobolSampler::SobolSampler(const int numSamples) :
+  Sampler(numSamples)
+{
+}
+
+void SobolSampler::generate(Point2D* samples, Random& random) const
+{
+  uint32_t scrambleX = random.next();
+  uint32_t scrambleY = random.next();
+
+  for (int i = 0; i < m_numSamples; i++) {
+    samples[i][0] = (reverseBits(i) ^ scrambleX) * (1.0 / 4294967296.0);
+    samples[i][1] = (sobol2(i) ^ scrambleY) * (1.0 / 4294967296.0);
+  }
+}
+
+/*
+  *************** BlueNoiseSampler **************
+*/
+
+BlueNoiseSampler::BlueNoiseSampler(const int numSamples) :
+  Sampler(numSamples),
+  m_points()
+{
+  // Fixed seed so every run uses the same pattern.
+  Random random(0x2545f491, 0);
+  static const int CANDIDATES_PER_POINT = 10;
+  static const int MAX_CANDIDATES = 64;
+
+  m_points.reserve(m_numSamples);
+  m_points.push_back(Point2D(random.nextDouble(), random.nextDouble()));
+  while ((int)m_points.size() < m_numSamples) {
+    // Keep the candidate furthest from the points so far, measuring
+    // distance on the torus so the pattern tiles seamlessly.
+    int numCandidates = std::min(CANDIDATES_PER_POINT * (int)m_points.size(), MAX_CANDIDATES);
+    Point2D best;
+    double bestDist = -1.0;
+    for (int c = 0; c < numCandidates; c++) {
+      Point2D candidate(random.nextDouble(), random.nextDouble());
+
+      double minDist = 2.0;
+      for (std::vector<Point2D>::const_iterator it = m_points.begin(); it != m_points.end(); it++) {
+        double dx = fabs(candidate[0] - (*it)[0]);
+        double dy = fabs(candidate[1] - (*it)[1]);
+        dx = std::min(dx, 1.0 - dx);
+        dy = std::min(dy, 1.0 - dy);
+        minDist = std::min(minDist, dx * dx + dy * dy);
+      }
+
+      if (minDist > bestDist) {
+        bestDist = minDist;
+        best = candidate;
+      }
+    }
+    m_points.push_back(best);
+  }
+}
+
+void BlueNoiseSampler::generate(Point2D* samples, Random& random) const
+{
+  double shiftX = random.nextDouble();
+  double shiftY = random.nextDouble();
+
+  for (int i = 0; i < m_numSamples; i++) {
+    samples[i][0] = wrap(m_points[i][0] + shiftX);
+    samples[i][1] = wrap(m_points[i][1] + shiftY);
+  }
+}
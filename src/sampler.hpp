@@ -0,0 +1,80 @@
+#ifndef SAMPLER_HPP
+#define SAMPLER_HPP
+
+#include <string>
+#include <vector>
+#include "algebra.hpp"
+#include "random.hpp"
+
+/*
+  Generates the 2D sample positions used for one pixel, either within the
+  pixel (anti-aliasing) or on the lens (depth of field).
+  Samplers are shared between threads; all per-pixel randomness comes
+  from the Random passed in, which decorrelates neighbouring pixels.
+*/
+class Sampler {
+ public:
+  Sampler(const int numSamples);
+  virtual ~Sampler();
+
+  // Fills samples with numSamples() points in [0, 1)^2.
+  virtual void generate(Point2D* samples, Random& random) const = 0;
+
+  int numSamples() const { return m_numSamples; }
+
+  static const int MAX_SAMPLES = 1024;
+
+ protected:
+  const int m_numSamples;
+};
+
+// Returns the sampler called name ("random", "stratified", "halton",
+// "sobol" or "bluenoise") or NULL if there isn't one.
+Sampler* createSampler(const std::string& name, const int numSamples);
+
+// Independent uniform samples.
+class RandomSampler : public Sampler {
+ public:
+  RandomSampler(const int numSamples);
+
+  void generate(Point2D* samples, Random& random) const;
+};
+
+// A jittered grid when numSamples is square, otherwise n-rooks sampling
+// so each row and column of the pixel still gets exactly one sample.
+class StratifiedSampler : public Sampler {
+ public:
+  StratifiedSampler(const int numSamples);
+
+  void generate(Point2D* samples, Random& random) const;
+};
+
+// Halton sequence in bases 2 and 3 with a random toroidal shift per pixel.
+class HaltonSampler : public Sampler {
+ public:
+  HaltonSampler(const int numSamples);
+
+  void generate(Point2D* samples, Random& random) const;
+};
+
+// First two dimensions of the Sobol sequence with random digit scrambling.
+class SobolSampler : public Sampler {
+ public:
+  SobolSampler(const int numSamples);
+
+  void generate(Point2D* samples, Random& random) const;
+};
+
+// A blue noise point set made once with Mitchell's best candidate algorithm
+// and given a random toroidal shift per pixel.
+class BlueNoiseSampler : public Sampler {
+ public:
+  BlueNoiseSampler(const int numSamples);
+
+  void generate(Point2D* samples, Random& random) const;
+
+ private:
+  std::vector<Point2D> m_points;
+};
+
+#endif
@@ -1,5 +1,7 @@
 #include "scene.hpp"
+#include "stats.hpp"
 #include <vector>
+#include <cfloat>
 
 Scene::Scene(SceneNode* root,
              int width, int height,
@@ -21,7 +23,9 @@ Scene::Scene(SceneNode* root,
   backgroundDist(screenDist + 1000.0), // TODO: Do this properly. Just assume nothing is past 1000 for now.
   background(std::vector<Point3D>(), std::vector<std::vector<int> >()),
   m_focalPlanePoint(),
-  m_hasFocalPlane(false)
+  m_hasFocalPlane(false),
+  m_nodes(),
+  m_bvh()
 {
   this->view.normalize();
   this->up.normalize();
@@ -53,21 +57,172 @@ Scene::Scene(SceneNode* root,
   background = Mesh(vertices, faces);
 }
 
+/*
+  Visitor stopping at the first node that blocks the ray.
+*/
+class OcclusionFinder : public BVH::Visitor {
+ public:
+  OcclusionFinder(const std::vector<WorldNode>& nodes, const Point3D& eye,
+                  const Vector3D& ray, const double tMin)
+    : m_occluded(false), m_nodes(nodes), m_eye(eye), m_ray(ray), m_tMin(tMin)
+  {}
+
+  bool visit(const int item, double& tMax) {
+    m_occluded = m_nodes[item].occluded(m_eye, m_ray, m_tMin, tMax);
+    return m_occluded;
+  }
+
+  bool m_occluded;
+
+ private:
+  const std::vector<WorldNode>& m_nodes;
+  const Point3D& m_eye;
+  const Vector3D& m_ray;
+  const double m_tMin;
+};
+
+/*
+  Visitor keeping the closest hit, shrinking the traversal as it goes.
+*/
+class ClosestNode : public BVH::Visitor {
+ public:
+  ClosestNode(const std::vector<WorldNode>& nodes, const Point3D& eye,
+              const Vector3D& ray, const double offset, IntersectionPoint& poi)
+    : m_closest(-1), m_nodes(nodes), m_eye(eye), m_ray(ray), m_offset(offset), m_poi(poi)
+  {}
+
+  bool visit(const int item, double& tMax) {
+    if (m_nodes[item].closestHit(m_eye, m_ray, m_offset, m_poi)) {
+      m_closest = item;
+      tMax = m_poi.m_t;
+    }
+    return false;
+  }
+
+  // Node owning m_poi, whose normal is still in that node's coordinates.
+  int m_closest;
+
+ private:
+  const std::vector<WorldNode>& m_nodes;
+  const Point3D& m_eye;
+  const Vector3D& m_ray;
+  const double m_offset;
+  IntersectionPoint& m_poi;
+};
+
+/*
+  ClosestNode for each ray of a packet.
+*/
+class ClosestNodes : public BVH::PacketVisitor {
+ public:
+  ClosestNodes(const std::vector<WorldNode>& nodes, const RayPacket& packet, IntersectionPoint pois[])
+    : m_nodes(nodes), m_packet(packet), m_pois(pois)
+  {
+    for (int i = 0; i < PACKET_SIZE; i++) {
+      m_closest[i] = -1;
+    }
+  }
+
+  void visit(const int item, const int lanes, Lanes& tMax) {
+    const int found = m_nodes[item].closestHit(m_packet, lanes, 0.0, m_pois);
+    for (int i = 0; found && i < PACKET_SIZE; i++) {
+      if (found & (1 << i)) {
+        m_closest[i] = item;
+        tMax[i] = m_pois[i].m_t;
+      }
+    }
+  }
+
+  int m_closest[PACKET_SIZE];
+
+ private:
+  const std::vector<WorldNode>& m_nodes;
+  const RayPacket& m_packet;
+  IntersectionPoint* m_pois;
+};
+
+void Scene::build()
+{
+  m_nodes.clear();
+  root->flatten(Matrix4x4(), m_nodes);
+
+  std::vector<BoundingBox> bounds;
+  for (std::vector<WorldNode>::const_iterator it = m_nodes.begin(); it != m_nodes.end(); it++) {
+    bounds.push_back(it->m_bounds);
+  }
+  m_bvh.build(bounds);
+}
+
 bool Scene::intersect(const double dx, const double dy, Colour& c) const
 {
+  countStat(STAT_PRIMARY_RAYS);
   Vector3D ray = getRay(dx, dy);
   return intersect(eye, ray, c);
 }
 
 bool Scene::intersect(const Point3D& start, const Vector3D& ray, Colour &c) const
 {
-  return root->intersect(start, ray, 0.0, c);
+  IntersectionPoint poi;
+  if (intersect(start, ray, 0.0, poi)) {
+    c = poi.m_owner->getColour(start, poi);
+    return true;
+  }
+
+  return false;
+}
+
+bool Scene::intersect(const Point3D& start, const Vector3D& ray, const double offset,
+                      IntersectionPoint& poi) const
+{
+  poi = IntersectionPoint(DBL_MAX);
+  ClosestNode closest(m_nodes, start, ray, offset, poi);
+  m_bvh.traverse(start, ray, offset, DBL_MAX, closest);
+
+  if (closest.m_closest >= 0) {
+    poi.m_normal = m_nodes[closest.m_closest].m_normalTrans * poi.m_normal;
+    poi.calcPOI(start, ray);
+    return true;
+  }
+
+  return false;
+}
+
+int Scene::intersect(const RayPacket& packet, IntersectionPoint pois[]) const
+{
+  countStat(STAT_PRIMARY_RAYS, packet.m_count);
+  for (int i = 0; i < PACKET_SIZE; i++) {
+    pois[i] = IntersectionPoint(DBL_MAX);
+  }
+
+  const Lanes tMin = Lanes();
+  Lanes tMax = Lanes() + DBL_MAX;
+  ClosestNodes closest(m_nodes, packet, pois);
+  m_bvh.traverse(packet, tMin, tMax, closest);
+
+  int hits = 0;
+  for (int i = 0; i < packet.m_count; i++) {
+    if (closest.m_closest[i] >= 0) {
+      pois[i].m_normal = m_nodes[closest.m_closest[i]].m_normalTrans * pois[i].m_normal;
+      pois[i].calcPOI(packet.m_eye, packet.ray(i));
+      hits |= 1 << i;
+    }
+  }
+
+  return hits;
+}
+
+bool Scene::occluded(const Point3D& start, const Vector3D& ray, const double tMin, const double tMax) const
+{
+  OcclusionFinder finder(m_nodes, start, ray, tMin);
+  m_bvh.traverse(start, ray, tMin, tMax, finder);
+
+  return finder.m_occluded;
 }
 
-Point3D Scene::getJitteredEye() const
+Point3D Scene::getLensEye(const Point2D& lensSample) const
 {
-  double xOffset = ((((double)rand() / (double)RAND_MAX) - 0.5)) / 4.0;
-  double yOffset = ((((double)rand() / (double)RAND_MAX) - 0.5)) / 4.0;
+  double xOffset = (lensSample[0] - 0.5) / 4.0;
+  double yOffset = (lensSample[1] - 0.5) / 4.0;
 
   return eye + xOffset * left + yOffset * up;
 }
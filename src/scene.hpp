@@ -5,6 +5,7 @@
 #include "scene_node.hpp"
 #include "light.hpp"
 #include "primitive.hpp"
+#include "bvh.hpp"
 
 class Scene {
  public:
@@ -15,10 +16,26 @@ class Scene {
         const Colour ambient,
         const std::list<Light*> lights);
 
+  // Builds the bounding volume hierarchy over the scene graph.
+  // Must be called once the scene graph is complete and before rendering.
+  void build();
+
   bool intersect(const double dx, const double dy, Colour &c) const;
   bool intersect(const Point3D& start, const Vector3D& ray, Colour &c) const;
 
-  Point3D getJitteredEye() const;
+  // Returns the closest intersection further than offset along the ray.
+  bool intersect(const Point3D& start, const Vector3D& ray, const double offset,
+                 IntersectionPoint& poi) const;
+
+  // The closest intersection of each ray in the packet, into pois[lane].
+  // Returns the lanes that hit something.
+  int intersect(const RayPacket& packet, IntersectionPoint pois[]) const;
+
+  // Whether an opaque object is crossed between tMin and tMax along the ray.
+  bool occluded(const Point3D& start, const Vector3D& ray, const double tMin, const double tMax) const;
+
+  // Moves the eye across the lens, lensSample being in [0, 1)^2.
+  Point3D getLensEye(const Point2D& lensSample) const;
   Vector3D getRay(const double dx, const double dy) const;
 
   // Returns background colour based on screen coordinates.
@@ -63,6 +80,13 @@ class Scene {
   // Depth of Field
   Point3D m_focalPlanePoint;
   bool m_hasFocalPlane;
+
+  // Top level of the acceleration structure. Each node referenced from
+  // several places in the graph appears once per path with its own world
+  // transform, but shares its primitive and that primitive's hierarchy
+  // (e.g. a Mesh's polygon BVH) with all of its other instances.
+  std::vector<WorldNode> m_nodes;
+  BVH m_bvh;
 };
 
 #endif
@@ -46,6 +46,7 @@
 #include "primitive.hpp"
 #include "image_primitive.hpp"
 #include "tree.hpp"
+#include "objloader.hpp"
 
 // Uncomment the following line to enable debugging messages
 // #define GRLUA_ENABLE_DEBUG
@@ -95,6 +96,13 @@ struct gr_light_ud {
   Light* light;
 };
 
+// The hierarchical primitives are all unit shapes positioned by their
+// node's transform, so every node shares a single copy of each one.
+static Sphere unitSphere;
+static Cone unitCone;
+static Cylinder unitCylinder;
+static Cube unitCube;
+
 // Useful function to retrieve and check an n-tuple of numbers.
 template<typename T>
 void get_tuple(lua_State* L, int arg, T* data, int n)
@@ -277,7 +285,7 @@ int gr_sphere_cmd(lua_State* L)
   data->node = 0;
   
   const char* name = luaL_checkstring(L, 1);
-  data->node = new GeometryNode(name, new Sphere());
+  data->node = new GeometryNode(name, &unitSphere);
 
   luaL_getmetatable(L, "gr.node");
   lua_setmetatable(L, -2);
@@ -295,7 +303,7 @@ int gr_cone_cmd(lua_State* L)
   data->node = 0;
   
   const char* name = luaL_checkstring(L, 1);
-  data->node = new GeometryNode(name, new Cone());
+  data->node = new GeometryNode(name, &unitCone);
 
   luaL_getmetatable(L, "gr.node");
   lua_setmetatable(L, -2);
@@ -313,7 +321,7 @@ int gr_cylinder_cmd(lua_State* L)
   data->node = 0;
   
   const char* name = luaL_checkstring(L, 1);
-  data->node = new GeometryNode(name, new Cylinder());
+  data->node = new GeometryNode(name, &unitCylinder);
 
   luaL_getmetatable(L, "gr.node");
   lua_setmetatable(L, -2);
@@ -331,7 +339,7 @@ int gr_cube_cmd(lua_State* L)
   data->node = 0;
   
   const char* name = luaL_checkstring(L, 1);
-  data->node = new GeometryNode(name, new Cube());
+  data->node = new GeometryNode(name, &unitCube);
 
   luaL_getmetatable(L, "gr.node");
   lua_setmetatable(L, -2);
@@ -473,6 +481,29 @@ int gr_mesh_cmd(lua_State* L)
   return 1;
 }
 
+// Create a polygonal mesh node from an OBJ file
+extern "C"
+int gr_obj_cmd(lua_State* L)
+{
+  GRLUA_DEBUG_CALL;
+
+  const char* name = luaL_checkstring(L, 1);
+  const char* filename = luaL_checkstring(L, 2);
+
+  Mesh* mesh = readObj(filename);
+  if (!mesh) {
+    return luaL_error(L, "Could not read mesh from %s", filename);
+  }
+
+  gr_node_ud* data = (gr_node_ud*)lua_newuserdata(L, sizeof(gr_node_ud));
+  data->node = new GeometryNode(name, mesh);
+
+  luaL_getmetatable(L, "gr.node");
+  lua_setmetatable(L, -2);
+
+  return 1;
+}
+
 // Make a point light
 extern "C"
 int gr_light_cmd(lua_State* L)
@@ -749,6 +780,7 @@ static const luaL_reg grlib_functions[] = {
   {"nh_sphere", gr_nh_sphere_cmd},
   {"nh_box", gr_nh_box_cmd},
   {"mesh", gr_mesh_cmd},
+  {"obj", gr_obj_cmd},
   {"light", gr_light_cmd},
   {"bump", gr_bump_cmd},
   {0, 0}
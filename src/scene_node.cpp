@@ -3,11 +3,15 @@
 #include <cfloat>
 #include "transforms.hpp"
 #include "scene.hpp"
+#include "stats.hpp"
 
 const Scene* SceneNode::m_scene = NULL;
 
 SceneNode::SceneNode(const std::string& name)
-  : m_name(name)
+  : m_name(name),
+    m_trans(),
+    m_invtrans(),
+    m_normaltrans()
 {
 }
 
@@ -50,10 +54,8 @@ bool SceneNode::intersect(const Point3D& eye, const Vector3D& ray, const double
 bool SceneNode::intersect(const Point3D& eye, const Vector3D& ray, const double offset,
                                          IntersectionPoint& poi) const
 {
-  SegmentList segments; 
-  intersect(eye, ray, segments);
-
-  if (segments.getMin(offset, poi)) {
+  poi = IntersectionPoint(DBL_MAX);
+  if (closestHit(eye, ray, offset, poi)) {
     poi.calcPOI(eye, ray);
     return true; 
   }
@@ -80,8 +82,77 @@ void SceneNode::intersect(const Point3D& eye, const Vector3D& ray,
       combineSegments(childSegments, tVals);
     }
 
-    tVals.transformNormals(m_invtrans.transpose());
+    tVals.transformNormals(m_normaltrans);
+  }
+}
+
+bool SceneNode::closestHit(const Point3D& eye, const Vector3D& ray, const double offset,
+                           IntersectionPoint& poi) const
+{
+  const Point3D transEye = m_invtrans * eye;
+  const Vector3D transRay = m_invtrans * ray;
+
+  bool found = false;
+  for (ChildList::const_iterator it = m_children.begin(); it != m_children.end(); it++) {
+    if ((*it)->closestHit(transEye, transRay, offset, poi)) {
+      found = true;
+    }
+  }
+
+  if (found) {
+    poi.m_normal = m_normaltrans * poi.m_normal;
   }
+
+  return found;
+}
+
+bool SceneNode::occluded(const Point3D& eye, const Vector3D& ray,
+                         const double tMin, const double tMax) const
+{
+  const Point3D transEye = m_invtrans * eye;
+  const Vector3D transRay = m_invtrans * ray;
+
+  for (ChildList::const_iterator it = m_children.begin(); it != m_children.end(); it++) {
+    if ((*it)->occluded(transEye, transRay, tMin, tMax)) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+void SceneNode::cacheBounds() const
+{
+  for (ChildList::const_iterator it = m_children.begin(); it != m_children.end(); it++) {
+    (*it)->cacheBounds();
+  }
+}
+
+// CSG results can only be found from the segments of the whole subtree.
+static bool segmentsOccluded(const SegmentList& segments, const double tMin, const double tMax)
+{
+  for (Segments::const_iterator it = segments.begin(); it != segments.end(); it++) {
+    if (it->m_start.m_t > tMin && it->m_start.m_t < tMax && it->m_start.m_owner->isOpaque()) {
+      return true;
+    }
+    if (it->m_end.m_t > tMin && it->m_end.m_t < tMax && it->m_end.m_owner->isOpaque()) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+static bool segmentsClosestHit(const SegmentList& segments, const double offset,
+                               IntersectionPoint& poi)
+{
+  IntersectionPoint hit;
+  if (segments.getMin(offset, hit) && hit.m_t < poi.m_t) {
+    poi = hit;
+    return true;
+  }
+
+  return false;
 }
 
 void SceneNode::combineSegments(SegmentList& s1, SegmentList& s2) const
@@ -89,10 +160,102 @@ void SceneNode::combineSegments(SegmentList& s1, SegmentList& s2) const
   s2.insert(s1);
 }
 
-Mesh* SceneNode::getBoundingBox()
+BoundingBox SceneNode::getBounds(const Matrix4x4& trans) const
 {
-  std::cerr << "Error! BoundingBox requested from SceneNode" << std::endl;
-  return NULL;
+  Matrix4x4 childTrans = trans * m_trans;
+
+  BoundingBox box;
+  for (ChildList::const_iterator it = m_children.begin(); it != m_children.end(); it++) {
+    box.extend((*it)->getBounds(childTrans));
+  }
+
+  return box;
+}
+
+void SceneNode::flatten(const Matrix4x4& trans, std::vector<WorldNode>& nodes) const
+{
+  Matrix4x4 childTrans = trans * m_trans;
+
+  for (ChildList::const_iterator it = m_children.begin(); it != m_children.end(); it++) {
+    (*it)->flatten(childTrans, nodes);
+  }
+}
+
+/*
+  ************ CSGNode ****************
+*/
+
+CSGNode::CSGNode(const std::string& name)
+  : SceneNode(name),
+    m_bounds(),
+    m_hasBounds(false)
+{}
+
+CSGNode::~CSGNode()
+{
+}
+
+void CSGNode::intersect(const Point3D& eye, const Vector3D& ray, SegmentList& tVals) const
+{
+  if (m_children.empty()) {
+    return;
+  }
+
+  // Segments can lie behind the eye, so test the whole line.
+  double tNear;
+  if (m_hasBounds &&
+      (m_bounds.isEmpty() || !m_bounds.intersect(eye, inverseRay(ray), -DBL_MAX, DBL_MAX, tNear))) {
+    return;
+  }
+
+  const Point3D transEye = m_invtrans * eye;
+  const Vector3D transRay = m_invtrans * ray;
+
+  SegmentList childSegments;
+  ChildList::const_iterator it = m_children.begin();
+  (*it)->intersect(transEye, transRay, childSegments);
+  tVals.insert(childSegments);
+  for (it++; it != m_children.end() && !tVals.empty(); it++) {
+    childSegments.clear();
+    (*it)->intersect(transEye, transRay, childSegments);
+    combineSegments(childSegments, tVals);
+  }
+
+  tVals.transformNormals(m_normaltrans);
+}
+
+bool CSGNode::occluded(const Point3D& eye, const Vector3D& ray,
+                       const double tMin, const double tMax) const
+{
+  SegmentList segments;
+  intersect(eye, ray, segments);
+
+  return segmentsOccluded(segments, tMin, tMax);
+}
+
+bool CSGNode::closestHit(const Point3D& eye, const Vector3D& ray, const double offset,
+                         IntersectionPoint& poi) const
+{
+  SegmentList segments;
+  intersect(eye, ray, segments);
+
+  return segmentsClosestHit(segments, offset, poi);
+}
+
+void CSGNode::flatten(const Matrix4x4& trans, std::vector<WorldNode>& nodes) const
+{
+  // Children can't be intersected independently.
+  cacheBounds();
+  nodes.push_back(WorldNode(this, trans));
+}
+
+void CSGNode::cacheBounds() const
+{
+  m_bounds = getBounds(Matrix4x4());
+  m_bounds.pad(epsilon);
+  m_hasBounds = true;
+
+  SceneNode::cacheBounds();
 }
 
 /*
@@ -100,7 +263,7 @@ Mesh* SceneNode::getBoundingBox()
 */
 
 IntersectionNode::IntersectionNode(const std::string& name)
-  : SceneNode(name)
+  : CSGNode(name)
 {}
 
 IntersectionNode:: ~IntersectionNode()
@@ -112,12 +275,28 @@ void IntersectionNode::combineSegments(SegmentList& s1, SegmentList& s2) const
   s2.intersect(s1);
 }
 
+BoundingBox IntersectionNode::getBounds(const Matrix4x4& trans) const
+{
+  Matrix4x4 childTrans = trans * m_trans;
+
+  BoundingBox box;
+  for (ChildList::const_iterator it = m_children.begin(); it != m_children.end(); it++) {
+    if (it == m_children.begin()) {
+      box = (*it)->getBounds(childTrans);
+    } else {
+      box.clip((*it)->getBounds(childTrans));
+    }
+  }
+
+  return box;
+}
+
 /*
   ************ DifferenceNode ****************
 */
 
 DifferenceNode::DifferenceNode(const std::string& name)
-  : SceneNode(name)
+  : CSGNode(name)
 {}
 
 DifferenceNode::~DifferenceNode()
@@ -128,6 +307,16 @@ void DifferenceNode::combineSegments(SegmentList& s1, SegmentList& s2) const
 {
   s2.remove(s1);
 }
+
+BoundingBox DifferenceNode::getBounds(const Matrix4x4& trans) const
+{
+  if (m_children.empty()) {
+    return BoundingBox();
+  }
+
+  return m_children.front()->getBounds(trans * m_trans);
+}
+
 /*
   ************ GeometryNode ****************
 */
@@ -145,35 +334,140 @@ GeometryNode::~GeometryNode()
 
 void GeometryNode::intersect(const Point3D& eye, const Vector3D& ray, SegmentList& tVals) const
 {
-  const Point3D transEye = m_invtrans * eye;
-  const Vector3D transRay = m_invtrans * ray;
+  intersectObject(m_invtrans * eye, m_invtrans * ray, tVals);
+  tVals.transformNormals(m_normaltrans);
+}
 
-  std::list<IntersectionPoint> tValues;
+void GeometryNode::intersectObject(const Point3D& transEye, const Vector3D& transRay,
+                                   SegmentList& tVals) const
+{
+  HitList tValues;
   if (m_primitive->filteredIntersect(transEye, transRay, tValues)) { 
-    std::list<IntersectionPoint>::iterator it = tValues.begin();
-    std::list<IntersectionPoint>::iterator next = tValues.begin();
-    next++;
-    for (; it != tValues.end(); it++, it++, next++, next++) {
+    for (int i = 0; i + 1 < tValues.size(); i += 2) {
+      IntersectionPoint& start = tValues[i];
+      IntersectionPoint& end = tValues[i + 1];
       // Filter out points that map to an alpha value of 0.
-      if (!m_material->hasZeroAlpha(m_primitive, transEye + it->m_t * transRay)) {
-        it->calcPrimitivePOI(transEye, transRay);
-        next->calcPrimitivePOI(transEye, transRay);
-        tVals.insert(*it, *next, this);
+      if (!m_material->hasZeroAlpha(m_primitive, transEye + start.m_t * transRay)) {
+        start.calcPrimitivePOI(transEye, transRay);
+        end.calcPrimitivePOI(transEye, transRay);
+        tVals.insert(start, end, this);
       } 
     }
-
-    tVals.transformNormals(m_invtrans.transpose());
   }
     if (tValues.size() % 2 != 0) std::cerr << m_name << std::endl; 
 }
 
-Mesh* GeometryNode::getBoundingBox()
+bool GeometryNode::closestHit(const Point3D& eye, const Vector3D& ray, const double offset,
+                              IntersectionPoint& poi) const
 {
-  Mesh* m = m_primitive->getBoundingBox();
+  if (closestHitObject(m_invtrans * eye, m_invtrans * ray, offset, poi)) {
+    poi.m_normal = m_normaltrans * poi.m_normal;
+    return true;
+  }
 
-  m->transform(m_trans);
+  return false;
+}
+
+bool GeometryNode::closestHitObject(const Point3D& transEye, const Vector3D& transRay,
+                                    const double offset, IntersectionPoint& poi) const
+{
+  HitList tValues;
+  if (!m_primitive->filteredIntersect(transEye, transRay, tValues)) {
+    return false;
+  }
 
-  return m;
+  return closestOfHits(transEye, transRay, tValues, offset, poi);
+}
+
+int GeometryNode::closestHitObject(const RayPacket& packet, const int lanes, const double offset,
+                                   IntersectionPoint pois[]) const
+{
+  HitList tValues[PACKET_SIZE];
+  m_primitive->intersectPacket(packet, lanes, tValues);
+
+  int found = 0;
+  for (int i = 0; i < PACKET_SIZE; i++) {
+    if ((lanes & (1 << i)) && closestOfHits(packet.m_eye, packet.ray(i), tValues[i], offset, pois[i])) {
+      found |= 1 << i;
+    }
+  }
+
+  return found;
+}
+
+bool GeometryNode::closestOfHits(const Point3D& transEye, const Vector3D& transRay,
+                                 const HitList& tValues, const double offset,
+                                 IntersectionPoint& poi) const
+{
+  // Same pairing and alpha filtering as the segments built by intersect.
+  const IntersectionPoint* closest = NULL;
+  double closestT = poi.m_t;
+  for (int i = 0; i + 1 < tValues.size(); i += 2) {
+    const IntersectionPoint& start = tValues[i];
+    const IntersectionPoint& end = tValues[i + 1];
+    if (m_material->hasZeroAlpha(m_primitive, transEye + start.m_t * transRay)) {
+      continue;
+    }
+
+    if (start.m_t > offset && start.m_t < closestT) {
+      closest = &start;
+      closestT = start.m_t;
+    } else if (end.m_t > offset && end.m_t < closestT) {
+      closest = &end;
+      closestT = end.m_t;
+    }
+  }
+
+  if (!closest) {
+    return false;
+  }
+
+  poi = *closest;
+  poi.m_owner = this;
+  poi.calcPrimitivePOI(transEye, transRay);
+
+  return true;
+}
+
+bool GeometryNode::occluded(const Point3D& eye, const Vector3D& ray,
+                            const double tMin, const double tMax) const
+{
+  return occludedObject(m_invtrans * eye, m_invtrans * ray, tMin, tMax);
+}
+
+bool GeometryNode::occludedObject(const Point3D& transEye, const Vector3D& transRay,
+                                  const double tMin, const double tMax) const
+{
+  if (!isOpaque()) {
+    return false;
+  }
+
+  if (!m_material->hasAlpha()) {
+    return m_primitive->anyHit(transEye, transRay, tMin, tMax);
+  }
+
+  // Points that map to an alpha value of 0 let the light through.
+  HitList tValues;
+  if (m_primitive->filteredIntersect(transEye, transRay, tValues)) {
+    for (HitList::const_iterator it = tValues.begin(); it != tValues.end(); it++) {
+      if (it->m_t > tMin && it->m_t < tMax &&
+          !m_material->hasZeroAlpha(m_primitive, transEye + it->m_t * transRay)) {
+        return true;
+      }
+    }
+  }
+
+  return false;
+}
+
+BoundingBox GeometryNode::getBounds(const Matrix4x4& trans) const
+{
+  return m_primitive->getBounds().transform(trans * m_trans);
+}
+
+void GeometryNode::flatten(const Matrix4x4& trans, std::vector<WorldNode>& nodes) const
+{
+  nodes.push_back(WorldNode(this, trans));
 }
 
 Colour GeometryNode::getColour(const Point3D& eye, const IntersectionPoint& poi, 
@@ -259,7 +553,8 @@ Colour GeometryNode::reflectionContribution(const Vector3D& viewDirection, const
     Vector3D mirrorDirection = -1 * viewDirection + 2 * viewDirection.dot(normal) * normal;
     IntersectionPoint objPOI;
     
-    if (m_scene->root->intersect(poi, mirrorDirection, epsilon,  objPOI)) {
+    countStat(STAT_REFLECTION_RAYS);
+    if (m_scene->intersect(poi, mirrorDirection, rayOffset(poi), objPOI)) {
       Colour c = objPOI.m_owner->getColour(poi, objPOI, refractiveIndex, recursiveDepth + 1);
     //std::cerr << "Re: " << c << " " ;
       return c;
@@ -287,7 +582,8 @@ Colour GeometryNode::refractionContribution(const Vector3D& viewDirection, const
   Vector3D transDirection = -indexRatio * viewDirection +
                              (indexRatio * cosInc - sqrt(1.0 - sinT2)) * normal;
   IntersectionPoint objPOI;
-  if (m_scene->root->intersect(poi, transDirection, epsilon, objPOI)) {
+  countStat(STAT_REFRACTION_RAYS);
+  if (m_scene->intersect(poi, transDirection, rayOffset(poi), objPOI)) {
     return objPOI.m_owner->getColour(poi, objPOI, n1 == 1.0 ? n2 : 1.0, recursiveDepth);
   } else {
     return m_scene->getBackground(poi, transDirection);
@@ -298,30 +594,21 @@ Colour GeometryNode::getLightContribution(const IntersectionPoint& poi, const Ve
                                           const Vector3D& normal) const
 {
   // Determine which lights are visible
-  std::list<Light*> lights; 
+  LightList lights; 
   for (std::list<Light*>::const_iterator it = m_scene->lights.begin(); it != m_scene->lights.end(); it++) {
     Light* light = (*it);
 
     Vector3D lightDirection = light->position - poi.m_poi; // Note this needs to point towards the light.
+    double lightDist = lightDirection.length();
     lightDirection.normalize();
 
     // Check if we get a contribution from this light (i.e. check if any objects are in the way)
     // Ignore transparent objects.
     // TODO: Add supprt for non-fully transparent objects.
     // TODO: If we ever start doing CSG with Refractive materials this won't work.
-    SegmentList segments;
-    m_scene->root->intersect(poi.m_poi, lightDirection, segments);
-    std::list<Segment> segs;
-    segments.getValidSegments(epsilon, segs);
-    bool exit = false;
-    for (std::list<Segment>::const_iterator it = segs.begin(); it != segs.end(); it++) {
-      if (it->m_start.m_owner->m_material->m_transparency == 0) {
-        exit = true;
-        break;
-      }
-    }
-    if (exit) {
-      break;
+    countStat(STAT_SHADOW_RAYS);
+    if (m_scene->occluded(poi.m_poi, lightDirection, rayOffset(poi.m_poi), lightDist)) {
+      continue;
     }
 
     lights.push_back(light);
@@ -330,3 +617,66 @@ Colour GeometryNode::getLightContribution(const IntersectionPoint& poi, const Ve
   return m_material->getColour(normal, viewDirection, lights, m_scene->ambient,
                                poi.m_primitivePOI, m_primitive);
 }
+
+/*
+  ************ WorldNode ****************
+*/
+
+WorldNode::WorldNode(const SceneNode* node, const Matrix4x4& trans)
+  : m_node(node),
+    m_geometry(NULL),
+    m_invtrans(trans.invert()),
+    m_normalTrans(m_invtrans.transpose()),
+    m_bounds(node->getBounds(trans))
+{
+  // Keep flat objects (e.g. squares) from having degenerate boxes.
+  m_bounds.pad(epsilon);
+}
+
+WorldNode::WorldNode(const GeometryNode* node, const Matrix4x4& trans)
+  : m_node(node),
+    m_geometry(node),
+    m_invtrans((trans * node->get_transform()).invert()),
+    m_normalTrans(m_invtrans.transpose()),
+    m_bounds(node->getBounds(trans))
+{
+  m_bounds.pad(epsilon);
+}
+
+bool WorldNode::occluded(const Point3D& eye, const Vector3D& ray,
+                         const double tMin, const double tMax) const
+{
+  if (m_geometry) {
+    return m_geometry->occludedObject(m_invtrans * eye, m_invtrans * ray, tMin, tMax);
+  }
+  return m_node->occluded(m_invtrans * eye, m_invtrans * ray, tMin, tMax);
+}
+
+bool WorldNode::closestHit(const Point3D& eye, const Vector3D& ray, const double offset,
+                           IntersectionPoint& poi) const
+{
+  if (m_geometry) {
+    return m_geometry->closestHitObject(m_invtrans * eye, m_invtrans * ray, offset, poi);
+  }
+  return m_node->closestHit(m_invtrans * eye, m_invtrans * ray, offset, poi);
+}
+
+int WorldNode::closestHit(const RayPacket& packet, const int lanes, const double offset,
+                          IntersectionPoint pois[]) const
+{
+  const RayPacket transPacket(m_invtrans, packet);
+  if (m_geometry) {
+    return m_geometry->closestHitObject(transPacket, lanes, offset, pois);
+  }
+
+  // Anything else takes the rays one at a time.
+  int found = 0;
+  for (int i = 0; i < PACKET_SIZE; i++) {
+    if ((lanes & (1 << i)) &&
+        m_node->closestHit(transPacket.m_eye, transPacket.ray(i), offset, pois[i])) {
+      found |= 1 << i;
+    }
+  }
+
+  return found;
+}
@@ -2,14 +2,52 @@
 #define SCENE_NODE_HPP
 
 #include <list>
+#include <vector>
 #include "algebra.hpp"
 #include "primitive.hpp"
 #include "material.hpp"
 #include "light.hpp"
 #include "segmentlist.hpp"
+#include "boundingbox.hpp"
 
 class GeometryNode;
 class Scene;
+class SceneNode;
+
+/*
+  A node placed in world coordinates by the combined transforms of all of
+  its ancestors. These are the items the scene's BVH is built over.
+  GeometryNodes also have their own transform folded in, so a ray goes
+  from world to object coordinates with a single multiplication however
+  deep the node was in the graph.
+*/
+struct WorldNode {
+  WorldNode(const SceneNode* node, const Matrix4x4& trans);
+  WorldNode(const GeometryNode* node, const Matrix4x4& trans);
+
+  // Intersect a world space ray with the node.
+  bool occluded(const Point3D& eye, const Vector3D& ray, const double tMin, const double tMax) const;
+  // Leaves the normal of the hit untransformed, multiply it by m_normalTrans
+  // once the closest hit over all nodes is known.
+  bool closestHit(const Point3D& eye, const Vector3D& ray, const double offset,
+                  IntersectionPoint& poi) const;
+  // closestHit for each ray of the packet set in lanes, into pois[lane].
+  // Returns the lanes that found a closer hit.
+  int closestHit(const RayPacket& packet, const int lanes, const double offset,
+                 IntersectionPoint pois[]) const;
+
+  const SceneNode* m_node;
+  // m_node if it's a GeometryNode, otherwise NULL.
+  const GeometryNode* m_geometry;
+
+  // Transforms from world coordinates to the node's parent coordinates,
+  // or to object coordinates for geometry.
+  Matrix4x4 m_invtrans;
+  // Transforms normals back to world coordinates.
+  Matrix4x4 m_normalTrans;
+
+  BoundingBox m_bounds;
+};
 
 class SceneNode {
 public:
@@ -23,12 +61,14 @@ public:
   {
     m_trans = m;
     m_invtrans = m.invert();
+    m_normaltrans = m_invtrans.transpose();
   }
 
   void set_transform(const Matrix4x4& m, const Matrix4x4& i)
   {
     m_trans = m;
     m_invtrans = i;
+    m_normaltrans = m_invtrans.transpose();
   }
 
   void add_child(SceneNode* child)
@@ -59,7 +99,27 @@ public:
   // Keeps track of the minimum t found so far to determine which object to return.
   virtual void intersect(const Point3D& eye, const Vector3D& ray, SegmentList& tVals) const;
 
-  virtual Mesh* getBoundingBox();
+  // Replaces poi with the closest hit further than offset along the ray if
+  // it's nearer than poi.m_t, returning whether it did. Union nodes only ever
+  // keep that one hit, CSG nodes have to build the segments of their subtree.
+  virtual bool closestHit(const Point3D& eye, const Vector3D& ray, const double offset,
+                          IntersectionPoint& poi) const;
+
+  // Whether the ray crosses the surface of an opaque object between tMin and tMax.
+  // Stops at the first one found, so it's cheaper than intersect for shadow rays.
+  virtual bool occluded(const Point3D& eye, const Vector3D& ray,
+                        const double tMin, const double tMax) const;
+
+  // Returns the bounds of this subtree after it's been transformed by trans.
+  virtual BoundingBox getBounds(const Matrix4x4& trans) const;
+
+  // Collects the nodes in this subtree that need to be intersected individually.
+  // Plain nodes are just a union of their children so they're flattened away,
+  // anything else is added to nodes with trans as its parent's world transform.
+  virtual void flatten(const Matrix4x4& trans, std::vector<WorldNode>& nodes) const;
+
+  // Lets the CSG nodes in this subtree precompute their bounds.
+  virtual void cacheBounds() const;
 
   std::string m_name;
 
@@ -74,6 +134,8 @@ protected:
   // Transformations
   Matrix4x4 m_trans;
   Matrix4x4 m_invtrans;
+  // Transforms normals back to the parent's coordinates.
+  Matrix4x4 m_normaltrans;
 
   // Hierarchy
   typedef std::list<SceneNode*> ChildList;
@@ -83,20 +145,51 @@ protected:
   static const Scene* m_scene;
 };
 
-class IntersectionNode : public SceneNode {
+/*
+  Base for the CSG nodes, whose children have to be intersected together.
+  Both intersection and difference are empty once the running result is,
+  so the remaining children are skipped, and rays missing the node's bounds
+  skip all of them.
+*/
+class CSGNode : public SceneNode {
+ public:
+  CSGNode(const std::string& name);
+  virtual ~CSGNode();
+
+  void intersect(const Point3D& eye, const Vector3D& ray, SegmentList& tVals) const;
+  bool occluded(const Point3D& eye, const Vector3D& ray, const double tMin, const double tMax) const;
+  bool closestHit(const Point3D& eye, const Vector3D& ray, const double offset,
+                  IntersectionPoint& poi) const;
+
+  void flatten(const Matrix4x4& trans, std::vector<WorldNode>& nodes) const;
+  void cacheBounds() const;
+
+ private:
+  // Bounds in the parent's coordinates, set by cacheBounds when the scene is built.
+  mutable BoundingBox m_bounds;
+  mutable bool m_hasBounds;
+};
+
+class IntersectionNode : public CSGNode {
  public:
   IntersectionNode(const std::string& name);
   virtual ~IntersectionNode();
 
+  // Overlap of the children's bounds.
+  BoundingBox getBounds(const Matrix4x4& trans) const;
+
  protected:
   void combineSegments(SegmentList& s1, SegmentList& s2) const;
 };
 
-class DifferenceNode : public SceneNode {
+class DifferenceNode : public CSGNode {
  public:
   DifferenceNode(const std::string& name);
   virtual ~DifferenceNode();
 
+  // Bounds of the first child, the one everything else is removed from.
+  BoundingBox getBounds(const Matrix4x4& trans) const;
+
  protected:
   void combineSegments(SegmentList& s1, SegmentList& s2) const;
 };
@@ -120,14 +213,34 @@ public:
 
   // Overwritten to do actual intersection
   void intersect(const Point3D& eye, const Vector3D& ray, SegmentList& tVals) const;
+  bool occluded(const Point3D& eye, const Vector3D& ray, const double tMin, const double tMax) const;
+  bool closestHit(const Point3D& eye, const Vector3D& ray, const double offset,
+                  IntersectionPoint& poi) const;
+
+  // The same queries with the ray already in object coordinates.
+  // Normals are left in object coordinates too.
+  void intersectObject(const Point3D& eye, const Vector3D& ray, SegmentList& tVals) const;
+  bool occludedObject(const Point3D& eye, const Vector3D& ray, const double tMin, const double tMax) const;
+  bool closestHitObject(const Point3D& eye, const Vector3D& ray, const double offset,
+                        IntersectionPoint& poi) const;
+  int closestHitObject(const RayPacket& packet, const int lanes, const double offset,
+                       IntersectionPoint pois[]) const;
 
-  Mesh* getBoundingBox();
+  // Transparent objects don't cast shadows.
+  bool isOpaque() const { return m_material->m_transparency == 0; }
+
+  BoundingBox getBounds(const Matrix4x4& trans) const;
+  void flatten(const Matrix4x4& trans, std::vector<WorldNode>& nodes) const;
 
 protected:
   PhongMaterial* m_material;
   Primitive* m_primitive;
 
 private:
+  // Picks the hit closestHitObject is after out of the primitive's hits.
+  bool closestOfHits(const Point3D& eye, const Vector3D& ray, const HitList& tValues,
+                     const double offset, IntersectionPoint& poi) const;
+
   double getReflectiveRatio(const Vector3D& viewDirection, const Vector3D& normal,
                             const double refractiveIndex) const;
   Colour reflectionContribution(const Vector3D& viewDirection, const Vector3D& normal, const Point3D& poi,
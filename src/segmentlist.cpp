@@ -1,40 +1,83 @@
 #include "segmentlist.hpp"
+#include "stats.hpp"
 #include <cfloat>
 #include <iostream>
 
 void SegmentList::insert(IntersectionPoint t1, IntersectionPoint t2, const GeometryNode* owner)
 {
-  SegmentList segment;
+  countStat(STAT_SEGMENT_INSERTS);
 
   t1.m_owner = owner;
   t2.m_owner = owner;
 
-  if (t1 < t2) {
-    m_segments.push_back(Segment(t1, t2));
+  Segment segment = t1 < t2 ? Segment(t1, t2) : Segment(t2, t1);
+
+  // Primitives give their segments in order, so this is almost always an append.
+  if (m_segments.empty() || m_segments.back().m_end < segment.m_start) {
+    m_segments.push_back(segment);
   } else {
-    m_segments.push_back(Segment(t2, t1));
+    SegmentList single;
+    single.m_segments.push_back(segment);
+    insert(single);
   }
 }
 
-void SegmentList::insert(SegmentList& segments)
+void SegmentList::insert(const SegmentList& segments)
 {
-  for (list<Segment>::iterator it = segments.m_segments.begin(); it != segments.m_segments.end(); it++) {
-    m_segments.push_back(*it);
+  countStat(STAT_SEGMENT_UNIONS);
+
+  if (segments.m_segments.empty()) {
+    return;
+  }
+  if (m_segments.empty()) {
+    m_segments = segments.m_segments;
+    return;
+  }
+
+  Segments newSegments;
+  Segments::const_iterator it1 = m_segments.begin();
+  Segments::const_iterator it2 = segments.m_segments.begin();
+  while (it1 != m_segments.end() || it2 != segments.m_segments.end()) {
+    // Take whichever segment starts first.
+    const Segment* next;
+    if (it2 == segments.m_segments.end() ||
+        (it1 != m_segments.end() && !(it2->m_start < it1->m_start))) {
+      next = &*it1++;
+    } else {
+      next = &*it2++;
+    }
+
+    if (!newSegments.empty() && !(newSegments.back().m_end < next->m_start)) {
+      // Overlaps the last one, so extend it.
+      if (newSegments.back().m_end < next->m_end) {
+        newSegments.back().m_end = next->m_end;
+      }
+    } else {
+      newSegments.push_back(*next);
+    }
   }
 
-  // TODO: Combine overlappings segements.
+  m_segments = newSegments;
 }
 
-void SegmentList::intersect(SegmentList& segments)
+void SegmentList::intersect(const SegmentList& segments)
 {
-  list<Segment> newSegments;
-  // TODO: This could be done a lot more efficiently.
-  for (list<Segment>::iterator it1 = segments.m_segments.begin(); it1 != segments.m_segments.end(); it1++) {
-    for (list<Segment>::iterator it2 = m_segments.begin(); it2 != m_segments.end(); it2++) {
-      if (it1->m_end > it2->m_start && it2->m_end > it1->m_start) {
-        newSegments.push_back(Segment(max(it1->m_start, it2->m_start),
-                                      min(it1->m_end, it2->m_end)));
-      }
+  countStat(STAT_SEGMENT_INTERSECTIONS);
+
+  Segments newSegments;
+  Segments::const_iterator it1 = segments.m_segments.begin();
+  Segments::const_iterator it2 = m_segments.begin();
+  while (it1 != segments.m_segments.end() && it2 != m_segments.end()) {
+    if (it1->m_end > it2->m_start && it2->m_end > it1->m_start) {
+      newSegments.push_back(Segment(max(it1->m_start, it2->m_start),
+                                    min(it1->m_end, it2->m_end)));
+    }
+
+    // Whichever ends first can't overlap anything else.
+    if (it1->m_end < it2->m_end) {
+      it1++;
+    } else {
+      it2++;
     }
   }
 
@@ -43,28 +86,39 @@ void SegmentList::intersect(SegmentList& segments)
   
 void SegmentList::remove(SegmentList& segments)
 {
+  countStat(STAT_SEGMENT_DIFFERENCES);
+
   // Flip normals.
-  for (list<Segment>::iterator it = segments.m_segments.begin(); it != segments.m_segments.end(); it++) {
+  for (Segments::iterator it = segments.m_segments.begin(); it != segments.m_segments.end(); it++) {
     it->flipNormals(); 
   }
 
-  list<Segment> newSegments;
-  // TODO: This could be done a lot more efficiently.
-  for (list<Segment>::iterator it2 = m_segments.begin(); it2 != m_segments.end(); it2++) {
-    bool keep = true;
-    for (list<Segment>::iterator it1 = segments.m_segments.begin(); it1 != segments.m_segments.end(); it1++) {
-      if (it1->m_end > it2->m_start && it2->m_end > it1->m_start) {
-        if (it2->m_start < it1->m_start) {
-          newSegments.push_back(Segment(it2->m_start, it1->m_start));
-        }
-        if (it2->m_end > it1->m_end) {
-          newSegments.push_back(Segment(it1->m_end, it2->m_end));
-        }
-        keep = false;
+  Segments newSegments;
+  Segments::const_iterator first = segments.m_segments.begin();
+  for (Segments::const_iterator it2 = m_segments.begin(); it2 != m_segments.end(); it2++) {
+    // Skip the holes that end before this segment starts. They end before
+    // every later segment starts too.
+    while (first != segments.m_segments.end() && !(first->m_end > it2->m_start)) {
+      first++;
+    }
+
+    // Cut each overlapping hole out of what's left of the segment.
+    IntersectionPoint start = it2->m_start;
+    bool remaining = true;
+    for (Segments::const_iterator it1 = first;
+         it1 != segments.m_segments.end() && it1->m_start < it2->m_end; it1++) {
+      if (start < it1->m_start) {
+        newSegments.push_back(Segment(start, it1->m_start));
+      }
+      if (!(it1->m_end < it2->m_end)) {
+        remaining = false;
+        break;
       }
+      start = it1->m_end;
     }
-    if (keep) {
-      newSegments.push_back(*it2);
+
+    if (remaining) {
+      newSegments.push_back(Segment(start, it2->m_end));
     }
   }
 
@@ -76,34 +130,25 @@ void SegmentList::clear()
   m_segments.clear();
 }
 
-bool SegmentList::getMin(const double offset, IntersectionPoint& poi)
+bool SegmentList::getMin(const double offset, IntersectionPoint& poi) const
 {
-  IntersectionPoint min(DBL_MAX);
-  for (list<Segment>::iterator it = m_segments.begin(); it != m_segments.end(); it++) {
-    if (it->start() > offset && it->m_start < min) {
-      min = it->m_start;
-    } else if (it->end() > offset && it->m_end < min) {
-      min = it->m_end;
+  // The first segment ending past offset holds the closest point.
+  for (Segments::const_iterator it = m_segments.begin(); it != m_segments.end(); it++) {
+    if (it->m_start.m_t > offset) {
+      poi = it->m_start;
+      return true;
+    } else if (it->m_end.m_t > offset) {
+      poi = it->m_end;
+      return true;
     }
   }
-  poi = min;
-
-  return min.m_t != DBL_MAX;
-}
 
-void SegmentList::getValidSegments(const double offset, list<Segment>& segments)
-{
-  for (list<Segment>::iterator it = m_segments.begin(); it != m_segments.end(); it++) {
-    if (it->start() > offset) {
-      segments.push_back(*it);
-    }
-  }
-  segments.sort();
+  return false;
 }
 
 void SegmentList::transformNormals(const Matrix4x4& m)
 {
-  for (list<Segment>::iterator it = m_segments.begin(); it != m_segments.end(); it++) {
+  for (Segments::iterator it = m_segments.begin(); it != m_segments.end(); it++) {
     it->m_start.m_normal = m * it->m_start.m_normal;
     it->m_end.m_normal = m * it->m_end.m_normal;
   }
@@ -1,17 +1,20 @@
 #ifndef SEGMENTLIST_HPP
 #define SEGMENTLIST_HPP
 
-#include <list>
 #include <cstddef>
 #include "algebra.hpp"
+#include "inlinevector.hpp"
 using namespace std;
 
 struct Segment {
+  Segment() :
+    m_start(), m_end()
+  {}
   Segment(const IntersectionPoint& start, const IntersectionPoint& end) :
     m_start(start), m_end(end) 
   {}
 
-  bool operator<(const Segment& other) {
+  bool operator<(const Segment& other) const {
     if (m_start.m_t == other.m_start.m_t) {
       return m_end < other.m_end;
     }
@@ -30,6 +33,13 @@ struct Segment {
   IntersectionPoint m_end;
 };
 
+typedef InlineVector<Segment, 8> Segments;
+
+/*
+  The parts of a ray inside some set of objects.
+  Segments are kept sorted and disjoint, so the CSG operations are single
+  linear sweeps over both lists.
+*/
 class SegmentList {
  public:
   SegmentList() :
@@ -37,19 +47,26 @@ class SegmentList {
   {}
 
   void insert(IntersectionPoint t1, IntersectionPoint t2, const GeometryNode* owner);
-  void insert(SegmentList& segments);
-  void intersect(SegmentList& segmens);
+  // Union, coalescing overlapping segments.
+  void insert(const SegmentList& segments);
+  void intersect(const SegmentList& segments);
+  // Flips the normals of segments, since their surfaces face the other way
+  // once they bound a hole.
   void remove(SegmentList& segments);
 
   void clear();
+  bool empty() const { return m_segments.empty(); }
+  int size() const { return m_segments.size(); }
 
-  bool getMin(const double offset, IntersectionPoint& poi);
-  void getValidSegments(const double offset, list<Segment>& segments);
+  bool getMin(const double offset, IntersectionPoint& poi) const;
 
   void transformNormals(const Matrix4x4& m);
 
+  Segments::const_iterator begin() const { return m_segments.begin(); }
+  Segments::const_iterator end() const { return m_segments.end(); }
+
  private:
-  list<Segment> m_segments;
+  Segments m_segments;
 };
 
 #endif
@@ -1,4 +1,5 @@
 #include "shapes.hpp"
+#include "stats.hpp"
 #include <cfloat>
 
 /* 
@@ -24,7 +25,7 @@ bool Polygon::checkPointForLine(const Point3D& p, const Point3D& p1, const Point
 }
 
 bool Polygon::intersect(const Point3D& eye, const Vector3D& ray, 
-                        std::list<IntersectionPoint>& tVals) const
+                        HitList& tVals) const
 {
   double t = m_plane.intersect(eye, ray); 
 
@@ -128,6 +129,248 @@ void Polygon::transform(const Matrix4x4& m)
   // We're screwing up the "up-vector" here, but who cares.
 }
 
+BoundingBox Polygon::getBounds() const
+{
+  BoundingBox box;
+  for (std::vector<Point3D>::const_iterator it = m_verts.begin(); it != m_verts.end(); it++) {
+    box.extend(*it);
+  }
+
+  return box;
+}
+
+/* 
+  ********** Triangle **********
+*/
+
+ShearedRay::ShearedRay(const Point3D& eye, const Vector3D& ray)
+  : m_eye(eye)
+{
+  const double x = fabs(ray[0]), y = fabs(ray[1]), z = fabs(ray[2]);
+  m_kz = x > y ? (x > z ? 0 : 2) : (y > z ? 1 : 2);
+  m_kx = (m_kz + 1) % 3;
+  m_ky = (m_kx + 1) % 3;
+
+  // Keep the winding of the triangles when looking down a negative axis.
+  if (ray[m_kz] < 0.0) {
+    std::swap(m_kx, m_ky);
+  }
+
+  m_sx = ray[m_kx] / ray[m_kz];
+  m_sy = ray[m_ky] / ray[m_kz];
+  m_sz = 1.0 / ray[m_kz];
+}
+
+ShearedPacket::ShearedPacket(const RayPacket& packet, const int lanes)
+  : m_valid(true),
+    m_eye(packet.m_eye),
+    m_kx(-1), m_ky(-1), m_kz(-1),
+    m_sx(), m_sy(), m_sz()
+{
+  for (int i = 0; i < PACKET_SIZE; i++) {
+    const ShearedRay ray(packet.m_eye, packet.ray(i));
+    if ((lanes & (1 << i)) && m_kz < 0) {
+      m_kx = ray.m_kx;
+      m_ky = ray.m_ky;
+      m_kz = ray.m_kz;
+    } else if ((lanes & (1 << i)) &&
+               (ray.m_kx != m_kx || ray.m_ky != m_ky || ray.m_kz != m_kz)) {
+      m_valid = false;
+    }
+
+    m_sx[i] = ray.m_sx;
+    m_sy[i] = ray.m_sy;
+    m_sz[i] = ray.m_sz;
+  }
+}
+
+Triangle::Triangle(const std::vector<Point3D>& verts, int v0, int v1, int v2, int face)
+  : m_face(face)
+{
+  m_v[0] = v0;
+  m_v[1] = v1;
+  m_v[2] = v2;
+
+  for (int i = 0; i < 3; i++) {
+    m_n[i] = m_uv[i] = -1;
+  }
+
+  // Same orientation as a Polygon built from the face.
+  m_normal = (verts[v2] - verts[v1]).cross(verts[v0] - verts[v1]);
+  m_normal.normalize();
+}
+
+// Tie break for a ray passing exactly through an edge, given the edge's
+// direction in the sheared plane. The triangle on the other side sees the
+// edge reversed, so only one of them takes it.
+static bool ownsEdge(const double dx, const double dy)
+{
+  return dy > 0.0 || (dy == 0.0 && dx > 0.0);
+}
+
+bool Triangle::intersect(const std::vector<Point3D>& verts, const ShearedRay& ray,
+                         double& t, double bary[3]) const
+{
+  countStat(STAT_TRIANGLE_TESTS);
+
+  const Vector3D a = verts[m_v[0]] - ray.m_eye;
+  const Vector3D b = verts[m_v[1]] - ray.m_eye;
+  const Vector3D c = verts[m_v[2]] - ray.m_eye;
+
+  // Vertices in the sheared plane, where the ray is the origin.
+  const double ax = a[ray.m_kx] - ray.m_sx * a[ray.m_kz];
+  const double ay = a[ray.m_ky] - ray.m_sy * a[ray.m_kz];
+  const double bx = b[ray.m_kx] - ray.m_sx * b[ray.m_kz];
+  const double by = b[ray.m_ky] - ray.m_sy * b[ray.m_kz];
+  const double cx = c[ray.m_kx] - ray.m_sx * c[ray.m_kz];
+  const double cy = c[ray.m_ky] - ray.m_sy * c[ray.m_kz];
+
+  // Scaled barycentrics, from the edge opposite each vertex.
+  const double u = cx * by - cy * bx;
+  const double v = ax * cy - ay * cx;
+  const double w = bx * ay - by * ax;
+
+  if ((u < 0.0 || v < 0.0 || w < 0.0) && (u > 0.0 || v > 0.0 || w > 0.0)) {
+    return false;
+  }
+
+  const double det = u + v + w;
+  if (det == 0.0) {
+    return false;
+  }
+
+  // A back facing triangle sees its edges reversed, flip them back so a ray
+  // grazing a silhouette edge hits both sides or neither.
+  const double s = det > 0.0 ? 1.0 : -1.0;
+  if ((u == 0.0 && !ownsEdge(s * (cx - bx), s * (cy - by))) ||
+      (v == 0.0 && !ownsEdge(s * (ax - cx), s * (ay - cy))) ||
+      (w == 0.0 && !ownsEdge(s * (bx - ax), s * (by - ay)))) {
+    return false;
+  }
+
+  const double az = ray.m_sz * a[ray.m_kz];
+  const double bz = ray.m_sz * b[ray.m_kz];
+  const double cz = ray.m_sz * c[ray.m_kz];
+
+  t = (u * az + v * bz + w * cz) / det;
+  bary[0] = u / det;
+  bary[1] = v / det;
+  bary[2] = w / det;
+
+  return true;
+}
+
+int Triangle::intersect(const std::vector<Point3D>& verts, const ShearedPacket& ray,
+                        const int lanes, Lanes& t, Lanes bary[3]) const
+{
+  countStat(STAT_TRIANGLE_TESTS, __builtin_popcount(lanes));
+
+  // The single ray test, step for step, so a packet hits exactly what its
+  // rays would on their own.
+  const Vector3D a = verts[m_v[0]] - ray.m_eye;
+  const Vector3D b = verts[m_v[1]] - ray.m_eye;
+  const Vector3D c = verts[m_v[2]] - ray.m_eye;
+
+  const Lanes ax = a[ray.m_kx] - ray.m_sx * a[ray.m_kz];
+  const Lanes ay = a[ray.m_ky] - ray.m_sy * a[ray.m_kz];
+  const Lanes bx = b[ray.m_kx] - ray.m_sx * b[ray.m_kz];
+  const Lanes by = b[ray.m_ky] - ray.m_sy * b[ray.m_kz];
+  const Lanes cx = c[ray.m_kx] - ray.m_sx * c[ray.m_kz];
+  const Lanes cy = c[ray.m_ky] - ray.m_sy * c[ray.m_kz];
+
+  const Lanes u = cx * by - cy * bx;
+  const Lanes v = ax * cy - ay * cx;
+  const Lanes w = bx * ay - by * ax;
+
+  const LaneMask outside = ((u < 0.0) | (v < 0.0) | (w < 0.0)) & ((u > 0.0) | (v > 0.0) | (w > 0.0));
+
+  const Lanes det = u + v + w;
+
+  const Lanes one = Lanes() + 1.0;
+  const Lanes s = det > 0.0 ? one : -one;
+  const Lanes uy = s * (cy - by), ux = s * (cx - bx);
+  const Lanes vy = s * (ay - cy), vx = s * (ax - cx);
+  const Lanes wy = s * (by - ay), wx = s * (bx - ax);
+  const LaneMask notOwned = ((u == 0.0) & ~((uy > 0.0) | ((uy == 0.0) & (ux > 0.0)))) |
+                            ((v == 0.0) & ~((vy > 0.0) | ((vy == 0.0) & (vx > 0.0)))) |
+                            ((w == 0.0) & ~((wy > 0.0) | ((wy == 0.0) & (wx > 0.0))));
+
+  const int hit = lanes & ~laneBits(outside | (det == 0.0) | notOwned);
+  if (!hit) {
+    return 0;
+  }
+
+  const Lanes az = ray.m_sz * a[ray.m_kz];
+  const Lanes bz = ray.m_sz * b[ray.m_kz];
+  const Lanes cz = ray.m_sz * c[ray.m_kz];
+
+  t = (u * az + v * bz + w * cz) / det;
+  bary[0] = u / det;
+  bary[1] = v / det;
+  bary[2] = w / det;
+
+  return hit;
+}
+
+bool Triangle::intersect(const std::vector<Point3D>& verts, const Point3D& p) const
+{
+  double dot = m_normal.dot(p - verts[m_v[0]]);
+  if (dot < -epsilon || dot > epsilon) {
+    return false;
+  }
+
+  // Same edge checks as Polygon.
+  for (int i = 0; i < 3; i++) {
+    const Point3D& p1 = verts[m_v[(i + 1) % 3]];
+    const Point3D& p2 = verts[m_v[i]];
+    if ((p1 - p2).cross(m_normal).dot(p - p1) >= tightEpsilon) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+void Triangle::barycentrics(const std::vector<Point3D>& verts, const Point3D& p, double bary[3]) const
+{
+  const Point3D& a = verts[m_v[0]];
+  const Point3D& b = verts[m_v[1]];
+  const Point3D& c = verts[m_v[2]];
+
+  // Signed areas of the triangles p makes with each edge.
+  const double area = m_normal.dot((b - a).cross(c - a));
+  bary[0] = m_normal.dot((b - p).cross(c - p)) / area;
+  bary[1] = m_normal.dot((c - p).cross(a - p)) / area;
+  bary[2] = 1.0 - bary[0] - bary[1];
+}
+
+Vector3D Triangle::getNormal(const std::vector<Vector3D>& normals, const double bary[3]) const
+{
+  if (m_n[0] < 0) {
+    return m_normal;
+  }
+
+  Vector3D normal = bary[0] * normals[m_n[0]] + bary[1] * normals[m_n[1]] + bary[2] * normals[m_n[2]];
+  normal.normalize();
+
+  // Refraction tells entering from leaving by the side the normal is on.
+  if (normal.dot(m_normal) < 0.0) {
+    normal = -1 * normal;
+  }
+
+  return normal;
+}
+
+BoundingBox Triangle::getBounds(const std::vector<Point3D>& verts) const
+{
+  BoundingBox box;
+  for (int i = 0; i < 3; i++) {
+    box.extend(verts[m_v[i]]);
+  }
+
+  return box;
+}
+
 /* 
   ********** Circle **********
 */
@@ -147,7 +390,7 @@ Circle::~Circle()
 }
 
 bool Circle::intersect(const Point3D& eye, const Vector3D& ray, 
-                       std::list<IntersectionPoint>& tVals) const
+                       HitList& tVals) const
 {
   double t = m_plane.intersect(eye, ray); 
 
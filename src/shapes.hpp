@@ -2,7 +2,7 @@
 #define SHAPES_HPP
 
 #include "algebra.hpp"
-#include <list>
+#include "boundingbox.hpp"
 #include <vector>
 
 struct Plane {
@@ -39,7 +39,7 @@ class Polygon {
   virtual ~Polygon();
 
   bool intersect(const Point3D& eye, const Vector3D& ray, 
-                 std::list<IntersectionPoint>& tVals) const;
+                 HitList& tVals) const;
   bool intersect(const Point3D& p) const;
   bool checkConstraint(const Point3D& p) const;
   Vector3D getNormal(const Point3D& p) const;
@@ -51,6 +51,8 @@ class Polygon {
 
   void transform(const Matrix4x4& m);
 
+  BoundingBox getBounds() const;
+
  private:
   bool checkPointForLine(const Point3D& p, const Point3D& p1, const Point3D& p2,
                          const Vector3D& normal) const;
@@ -59,6 +61,79 @@ class Polygon {
   Plane m_plane;
 };
 
+/*
+  A ray set up for the watertight triangle test. The axes are permuted so
+  that the ray's largest component is z and the shear takes the ray onto it.
+  Set up once per ray and shared by every triangle it's tested against.
+*/
+struct ShearedRay {
+  ShearedRay(const Point3D& eye, const Vector3D& ray);
+
+  Point3D m_eye;
+  int m_kx, m_ky, m_kz;
+  double m_sx, m_sy, m_sz;
+};
+
+/*
+  ShearedRays for a packet whose rays all use the same axes, as neighbouring
+  camera rays nearly always do. Each lane holds its ray's shear.
+*/
+struct ShearedPacket {
+  ShearedPacket(const RayPacket& packet, const int lanes);
+
+  // False if the rays in lanes need different axes.
+  bool m_valid;
+
+  Point3D m_eye;
+  int m_kx, m_ky, m_kz;
+  Lanes m_sx, m_sy, m_sz;
+};
+
+/*
+  A mesh triangle. It refers to the mesh's shared vertices, so neighbouring
+  triangles test exactly the same edges.
+*/
+class Triangle {
+ public:
+  Triangle() {}
+  Triangle(const std::vector<Point3D>& verts, int v0, int v1, int v2, int face);
+
+  // Watertight test over the whole line. If a ray passes through an edge or
+  // vertex, exactly one of the triangles sharing it that face the same way
+  // counts the hit. Gives back the distance and the barycentric weight of
+  // each vertex.
+  bool intersect(const std::vector<Point3D>& verts, const ShearedRay& ray,
+                 double& t, double bary[3]) const;
+
+  // The same test for every ray of the packet set in lanes. Returns the
+  // lanes that hit.
+  int intersect(const std::vector<Point3D>& verts, const ShearedPacket& ray, const int lanes,
+                Lanes& t, Lanes bary[3]) const;
+
+  // Whether p is on the triangle, within epsilon.
+  bool intersect(const std::vector<Point3D>& verts, const Point3D& p) const;
+
+  // Barycentric weights of a point on the triangle.
+  void barycentrics(const std::vector<Point3D>& verts, const Point3D& p, double bary[3]) const;
+
+  // Normal to shade with. Interpolated from the vertex normals if the
+  // triangle has them, turned to the same side as the face.
+  Vector3D getNormal(const std::vector<Vector3D>& normals, const double bary[3]) const;
+
+  BoundingBox getBounds(const std::vector<Point3D>& verts) const;
+
+  int m_v[3];
+
+  // Indices of the vertex normals and texture coordinates, -1 if there are none.
+  int m_n[3];
+  int m_uv[3];
+
+  // Index of the mesh face the triangle was cut from.
+  int m_face;
+
+  Vector3D m_normal;
+};
+
 class Circle {
  public:
   Circle(const Vector3D& normal, const Point3D& center, double radius);
@@ -66,7 +141,7 @@ class Circle {
   virtual ~Circle();
 
   bool intersect(const Point3D& eye, const Vector3D& ray, 
-                 std::list<IntersectionPoint>& tVals) const;
+                 HitList& tVals) const;
   Vector3D getNormal(const Point3D& p) const;
   Point2D textureMapCoords(const Point3D& p) const;
 
@@ -0,0 +1,133 @@
+#include "stats.hpp"
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <pthread.h>
+#include <sys/time.h>
+
+__thread long* t_statCounters = NULL;
+
+static const char* COUNTER_NAMES[NUM_STAT_COUNTERS] = {
+  "primary_rays",
+  "shadow_rays",
+  "reflection_rays",
+  "refraction_rays",
+  "sphere_tests",
+  "box_tests",
+  "cone_tests",
+  "cylinder_tests",
+  "mesh_tests",
+  "triangle_tests",
+  "image_tests",
+  "bounds_tests",
+  "bvh_nodes",
+  "segment_inserts",
+  "segment_unions",
+  "segment_intersections",
+  "segment_differences",
+  "duplicate_hits"
+};
+
+static const char* PHASE_NAMES[NUM_STAT_PHASES] = {
+  "load",
+  "build",
+  "render",
+  "encode"
+};
+
+static bool s_enabled = false;
+
+// Every thread's counters, kept until the program exits so they can be
+// summed after the threads are gone.
+static pthread_mutex_t s_countersLock = PTHREAD_MUTEX_INITIALIZER;
+static std::vector<long*> s_counters;
+
+static double s_phaseStart[NUM_STAT_PHASES];
+static double s_phaseTime[NUM_STAT_PHASES];
+
+static double currentTime()
+{
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+
+  return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+void enableStats()
+{
+  s_enabled = true;
+  startThreadStats();
+}
+
+bool statsEnabled()
+{
+  return s_enabled;
+}
+
+void startThreadStats()
+{
+  if (!s_enabled || t_statCounters) {
+    return;
+  }
+
+  long* counters = new long[NUM_STAT_COUNTERS]();
+  pthread_mutex_lock(&s_countersLock);
+  s_counters.push_back(counters);
+  pthread_mutex_unlock(&s_countersLock);
+
+  t_statCounters = counters;
+}
+
+void startPhase(const StatPhase phase)
+{
+  if (s_enabled) {
+    s_phaseStart[phase] = currentTime();
+  }
+}
+
+void endPhase(const StatPhase phase)
+{
+  if (s_enabled) {
+    s_phaseTime[phase] += currentTime() - s_phaseStart[phase];
+  }
+}
+
+void reportStats(const std::string& format)
+{
+  if (!s_enabled) {
+    return;
+  }
+
+  long totals[NUM_STAT_COUNTERS] = { 0 };
+  pthread_mutex_lock(&s_countersLock);
+  for (std::vector<long*>::const_iterator it = s_counters.begin(); it != s_counters.end(); it++) {
+    for (int i = 0; i < NUM_STAT_COUNTERS; i++) {
+      totals[i] += (*it)[i];
+    }
+  }
+  pthread_mutex_unlock(&s_countersLock);
+
+  if (format == "json") {
+    std::cout << "{\n  \"counters\": {\n";
+    for (int i = 0; i < NUM_STAT_COUNTERS; i++) {
+      std::cout << "    \"" << COUNTER_NAMES[i] << "\": " << totals[i]
+                << (i + 1 < NUM_STAT_COUNTERS ? ",\n" : "\n");
+    }
+    std::cout << "  },\n  \"seconds\": {\n";
+    for (int i = 0; i < NUM_STAT_PHASES; i++) {
+      std::cout << "    \"" << PHASE_NAMES[i] << "\": " << s_phaseTime[i]
+                << (i + 1 < NUM_STAT_PHASES ? ",\n" : "\n");
+    }
+    std::cout << "  }\n}" << std::endl;
+    return;
+  }
+
+  for (int i = 0; i < NUM_STAT_COUNTERS; i++) {
+    std::cerr << std::left << std::setw(24) << COUNTER_NAMES[i]
+              << std::right << std::setw(16) << totals[i] << std::endl;
+  }
+  for (int i = 0; i < NUM_STAT_PHASES; i++) {
+    std::cerr << std::left << std::setw(24) << (std::string(PHASE_NAMES[i]) + "_seconds")
+              << std::right << std::setw(16) << s_phaseTime[i] << std::endl;
+  }
+}
@@ -0,0 +1,91 @@
+#ifndef STATS_HPP
+#define STATS_HPP
+
+#include <string>
+
+/*
+  Opt in counters of what a render spends its time on.
+  Each thread counts into its own array, so counting is a plain increment,
+  and the arrays are only summed when the report is printed. Threads that
+  never call startThreadStats, and every thread while stats are disabled,
+  count nothing at the cost of one test.
+*/
+
+enum StatCounter {
+  STAT_PRIMARY_RAYS,
+  STAT_SHADOW_RAYS,
+  STAT_REFLECTION_RAYS,
+  STAT_REFRACTION_RAYS,
+
+  // Ray tests against each type of primitive.
+  STAT_SPHERE_TESTS,
+  STAT_BOX_TESTS,
+  STAT_CONE_TESTS,
+  STAT_CYLINDER_TESTS,
+  STAT_MESH_TESTS,
+  STAT_TRIANGLE_TESTS,
+  STAT_IMAGE_TESTS,
+
+  // Ray tests against bounding boxes and the bounding spheres of meshes,
+  // and hierarchy nodes visited.
+  STAT_BOUNDS_TESTS,
+  STAT_BVH_NODES,
+
+  STAT_SEGMENT_INSERTS,
+  STAT_SEGMENT_UNIONS,
+  STAT_SEGMENT_INTERSECTIONS,
+  STAT_SEGMENT_DIFFERENCES,
+
+  // Hits dropped by filteredIntersect as repeats of the one before.
+  STAT_DUPLICATE_HITS,
+
+  NUM_STAT_COUNTERS
+};
+
+enum StatPhase {
+  PHASE_LOAD,
+  PHASE_BUILD,
+  PHASE_RENDER,
+  PHASE_ENCODE,
+
+  NUM_STAT_PHASES
+};
+
+// The calling thread's counters, or NULL if it isn't counting.
+extern __thread long* t_statCounters;
+
+// Starts counting on the calling thread, and on every thread that calls
+// startThreadStats afterwards.
+void enableStats();
+bool statsEnabled();
+void startThreadStats();
+
+inline void countStat(const StatCounter counter, const long n = 1)
+{
+  if (t_statCounters) {
+    t_statCounters[counter] += n;
+  }
+}
+
+// Ray tests against primitives, triangles and bounding boxes so far on the
+// calling thread, or 0 if it isn't counting.
+inline long threadIntersectionTests()
+{
+  long tests = 0;
+  if (t_statCounters) {
+    for (int i = STAT_SPHERE_TESTS; i <= STAT_BOUNDS_TESTS; i++) {
+      tests += t_statCounters[i];
+    }
+  }
+  return tests;
+}
+
+// Phases are timed from the main thread.
+void startPhase(const StatPhase phase);
+void endPhase(const StatPhase phase);
+
+// Sums the counters of every thread that has counted. Format is "table",
+// printed to stderr, or "json", printed to stdout.
+void reportStats(const std::string& format);
+
+#endif
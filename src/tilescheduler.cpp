@@ -0,0 +1,89 @@
+#include "tilescheduler.hpp"
+#include <algorithm>
+
+TileScheduler::TileScheduler(const int width, const int height, const int tileSize,
+                             const int numThreads)
+  : m_queues(), m_numTiles(0)
+{
+  std::vector<Tile> tiles;
+  for (int y = 0; y < height; y += tileSize) {
+    for (int x = 0; x < width; x += tileSize) {
+      Tile tile;
+      tile.x0 = x;
+      tile.y0 = y;
+      tile.x1 = std::min(x + tileSize, width);
+      tile.y1 = std::min(y + tileSize, height);
+      tiles.push_back(tile);
+    }
+  }
+  m_numTiles = tiles.size();
+
+  // Give each thread a contiguous block so neighbouring tiles stay on one thread
+  // until the stealing starts.
+  for (int i = 0; i < numThreads; i++) {
+    Queue* queue = new Queue;
+    pthread_mutex_init(&queue->m_lock, NULL);
+
+    int first = (long)m_numTiles * i / numThreads;
+    int last = (long)m_numTiles * (i + 1) / numThreads;
+    queue->m_tiles.assign(tiles.begin() + first, tiles.begin() + last);
+
+    m_queues.push_back(queue);
+  }
+}
+
+TileScheduler::~TileScheduler()
+{
+  for (std::vector<Queue*>::iterator it = m_queues.begin(); it != m_queues.end(); it++) {
+    pthread_mutex_destroy(&(*it)->m_lock);
+    delete *it;
+  }
+}
+
+bool TileScheduler::nextTile(const int thread, Tile& tile, bool& stolen)
+{
+  stolen = false;
+  if (popFront(m_queues[thread], tile)) {
+    return true;
+  }
+
+  int numThreads = m_queues.size();
+  for (int i = 1; i < numThreads; i++) {
+    if (popBack(m_queues[(thread + i) % numThreads], tile)) {
+      stolen = true;
+      return true;
+    }
+  }
+
+  return false;
+}
+
+bool TileScheduler::popFront(Queue* queue, Tile& tile)
+{
+  bool found = false;
+
+  pthread_mutex_lock(&queue->m_lock);
+  if (!queue->m_tiles.empty()) {
+    tile = queue->m_tiles.front();
+    queue->m_tiles.pop_front();
+    found = true;
+  }
+  pthread_mutex_unlock(&queue->m_lock);
+
+  return found;
+}
+
+bool TileScheduler::popBack(Queue* queue, Tile& tile)
+{
+  bool found = false;
+
+  pthread_mutex_lock(&queue->m_lock);
+  if (!queue->m_tiles.empty()) {
+    tile = queue->m_tiles.back();
+    queue->m_tiles.pop_back();
+    found = true;
+  }
+  pthread_mutex_unlock(&queue->m_lock);
+
+  return found;
+}
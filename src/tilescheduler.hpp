@@ -0,0 +1,43 @@
+#ifndef TILESCHEDULER_HPP
+#define TILESCHEDULER_HPP
+
+#include <deque>
+#include <vector>
+#include <pthread.h>
+
+// A rectangle of pixels [x0, x1) x [y0, y1).
+struct Tile {
+  int x0, y0;
+  int x1, y1;
+};
+
+/*
+  Splits an image into tiles and hands them out to render threads.
+  Each thread starts with its own contiguous block of tiles and once that
+  runs out it steals tiles from the back of the other threads' queues.
+*/
+class TileScheduler {
+ public:
+  TileScheduler(const int width, const int height, const int tileSize, const int numThreads);
+  ~TileScheduler();
+
+  // Gets the next tile for thread. stolen is set if it came from another
+  // thread's queue. Returns false once there are no tiles left anywhere.
+  bool nextTile(const int thread, Tile& tile, bool& stolen);
+
+  int numTiles() const { return m_numTiles; }
+
+ private:
+  struct Queue {
+    std::deque<Tile> m_tiles;
+    pthread_mutex_t m_lock;
+  };
+
+  bool popFront(Queue* queue, Tile& tile);
+  bool popBack(Queue* queue, Tile& tile);
+
+  std::vector<Queue*> m_queues;
+  int m_numTiles;
+};
+
+#endif
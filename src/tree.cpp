@@ -4,6 +4,11 @@
 
 static TextureMap wood("wood_texture.png", Colour(0.0, 0.0, 0.0), 5, 0.0, 0.0);
 
+// Every branch and leaf is an instance of one of these.
+static Cylinder branchCylinder;
+static Sphere branchTop;
+static ImagePrimitive leafSquare;
+
 static int totalBranches = 0;
 static int totalLeaves = 0;
 
@@ -93,7 +98,7 @@ Tree::~Tree()
 */
 
 Branch::Branch(const std::string& name, int level, const double thickness, const double length)
-  : SceneNode(name), m_boundingBox()
+  : SceneNode(name), m_bounds()
 {
   createLeaves(level, thickness, length);
 
@@ -115,7 +120,7 @@ Branch::Branch(const std::string& name, int level, const double thickness, const
 
 Branch::Branch(const std::string& name, int level, const double thickness, const double length, 
                double upDist, double upAngle, double zAngle)
-  : SceneNode(name), m_boundingBox()
+  : SceneNode(name), m_bounds()
 {
   double branchLength = length;
   if (level == 1) {
@@ -137,8 +142,7 @@ Branch::~Branch()
 void Branch::createGeometryNode(const double length, const double thickness, const double upDist,
                                 const double upAngle, const double zAngle)
 {  
-  Cylinder* c_branch= new Cylinder;
-  GeometryNode* branch = new GeometryNode("TreeTrunk", c_branch);
+  GeometryNode* branch = new GeometryNode("TreeTrunk", &branchCylinder);
   branch->set_material(&wood);
 
   this->rotate('z', zAngle);
@@ -169,8 +173,7 @@ void Branch::spawnSubBranches(const int level, const double length, const double
   add_child(new Branch("SplitBranch", level + 1, nextThickness(thickness, level), 
                        nextLength(length, level), length, 30.0, 0.0));
   // Two branches coming out of the top looks a little weird so add a sphere.
-  Sphere* p_sphere = new Sphere();
-  GeometryNode* sphere = new GeometryNode("BranchTop", p_sphere);
+  GeometryNode* sphere = new GeometryNode("BranchTop", &branchTop);
   sphere->set_material(&wood);
 
   sphere->translate(Vector3D(0.0, 0.0, length));
@@ -193,54 +196,14 @@ void Branch::createLeaves(const int level, const double thickness, const double
 
 void Branch::createBoundingBox()
 {
-  double minX, minY, minZ;
-  double maxX, maxY, maxZ;
-  minX = minY = minZ = DBL_MAX;
-  maxX = maxY = maxZ = -DBL_MAX;
-
-  double extremePoints[6]; 
   for (std::list<SceneNode*>::iterator it = m_children.begin(); it != m_children.end(); it++) {
-    // Combine each one.
-    Mesh* m = (*it)->getBoundingBox();
-    m->getExtremePoints(extremePoints);
-    delete m;
-
-    if (extremePoints[0] < minX) minX = extremePoints[0];
-    if (extremePoints[1] > maxX) maxX = extremePoints[1];
-    if (extremePoints[2] < minY) minY = extremePoints[2];
-    if (extremePoints[3] > maxY) maxY = extremePoints[3];
-    if (extremePoints[4] < minZ) minZ = extremePoints[4];
-    if (extremePoints[5] > maxZ) maxZ = extremePoints[5];
+    m_bounds.extend((*it)->getBounds(Matrix4x4()));
   }
-
-  std::vector<Point3D> vertices;
-  vertices.push_back(Point3D(minX, minY, minZ));
-  vertices.push_back(Point3D(maxX, minY, minZ));
-  vertices.push_back(Point3D(maxX, maxY, minZ));
-  vertices.push_back(Point3D(minX, maxY, minZ));
-  vertices.push_back(Point3D(minX, minY, maxZ));
-  vertices.push_back(Point3D(maxX, minY, maxZ));
-  vertices.push_back(Point3D(maxX, maxY, maxZ));
-  vertices.push_back(Point3D(minX, maxY, maxZ));
-
-  std::vector<std::vector<int> > f;
-  int faces[6][4] = { {3, 2, 1, 0}, // Front
-                      {0, 1, 5, 4}, // Bottom
-                      {2, 6, 5, 1}, // Right
-                      {7, 3, 0, 4}, // Left
-                      {7, 6, 2, 3}, // Top
-                      {4, 5, 6, 7}}; // Back
-  for (int i = 0; i < 6; i++) f.push_back(std::vector<int> (faces[i], faces[i] + 4));
-
-  m_boundingBox = Mesh(vertices, f);
 }
 
-Mesh* Branch::getBoundingBox()
+BoundingBox Branch::getBounds(const Matrix4x4& trans) const
 {
-  Mesh* m = new Mesh(m_boundingBox);
-  m->transform(m_trans);
-
-  return m;
+  return m_bounds.transform(trans * m_trans);
 }
 
 void Branch::intersect(const Point3D& eye, const Vector3D& ray, SegmentList& tVals) const
@@ -248,9 +211,9 @@ void Branch::intersect(const Point3D& eye, const Vector3D& ray, SegmentList& tVa
   const Point3D transEye = m_invtrans * eye;
   const Vector3D transRay = m_invtrans * ray;
 
-  // Check bounding box;
-  std::list<IntersectionPoint> dummyTVals;
-  if (m_boundingBox.intersect(transEye, transRay, dummyTVals)) {
+  // Check bounding box, anywhere along the line since segments behind the eye still count.
+  double tNear;
+  if (m_bounds.intersect(transEye, inverseRay(transRay), -DBL_MAX, DBL_MAX, tNear)) {
     return SceneNode::intersect(eye, ray, tVals);
   }
 }
@@ -264,8 +227,7 @@ static TextureMap leafTexture("leaf.png", Colour(0.0, 0.0, 0.0), 5, 0.0, 0.0);
 Leaf::Leaf(const std::string& name, const double branchThickness, const double branchLength)
   : SceneNode(name)
 {
-  ImagePrimitive* i_leaf = new ImagePrimitive();
-  GeometryNode* leaf = new GeometryNode("Leaf", i_leaf);
+  GeometryNode* leaf = new GeometryNode("Leaf", &leafSquare);
   leaf->set_material(&leafTexture);
 
   double upDist = rand(1.0/3.0, 1.0, branchLength);
@@ -283,8 +245,3 @@ Leaf::Leaf(const std::string& name, const double branchThickness, const double b
 Leaf::~Leaf()
 {
 }
-  
-Mesh* Leaf::getBoundingBox()
-{
-  return m_children.front()->getBoundingBox();
-}
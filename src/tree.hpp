@@ -25,8 +25,8 @@ class Branch : public SceneNode {
                double upDist, double upAngle, double zAngle);
   ~Branch();
 
-  Mesh* getBoundingBox();
-  
+  BoundingBox getBounds(const Matrix4x4& trans) const;
+
   void intersect(const Point3D& eye, const Vector3D& ray, SegmentList& tVals) const;
 
  private:
@@ -36,16 +36,15 @@ class Branch : public SceneNode {
   void createLeaves(const int level, const double thickness, const double branchLength);
 
   void createBoundingBox();
-  
-  Mesh m_boundingBox;
+
+  // Bounds of the children in the branch's own coordinates.
+  BoundingBox m_bounds;
 };
 
 class Leaf : public SceneNode {
  public:
   Leaf(const std::string& name, const double branchThickness, const double branchLength);
   ~Leaf();
-
-  Mesh* getBoundingBox();
 };
 
 #endif